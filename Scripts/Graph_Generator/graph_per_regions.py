@@ -86,6 +86,18 @@ try:
         return state_totals, state_percentages
     #state_to_percent_df
 
+    # A log written with -log=changes only has the cells that changed on a day,
+    # the others are added to the day with the state they were last logged in
+    def repeat_unchanged(sim_time, curr_states, logged, data_percents, data_totals):
+        if sim_time is not None:
+            for cid in curr_states:
+                if not cid in logged:
+                    state_totals, state_percentages = state_to_df(sim_time, curr_states[cid])
+                    data_percents[cid].append(state_percentages)
+                    data_totals[cid].append(state_totals)
+        logged.clear()
+    #repeat_unchanged
+
     # Generates graph for one region_key
     def generate_graph(path, data_percents, data_totals, curr_states, region_key):
         import matplotlib.pyplot as plt # Needs this for multi-processing
@@ -224,6 +236,7 @@ try:
 
         curr_time     = None
         curr_states   = {}
+        logged        = set() # Cells with a line at curr_time
         initial_pop   = {}
         data_percents = {}
         data_totals   = {}
@@ -239,6 +252,8 @@ try:
 
                 # If a time marker is found that is not the current time
                 if line.isnumeric() and line != curr_time:
+                    repeat_unchanged(curr_time, curr_states, logged, data_percents, data_totals)
+
                     # Update new simulation time
                     curr_time = line
                     continue
@@ -263,6 +278,7 @@ try:
                 state            = state_match.group().strip("<>")
                 state            = list(map(float, state.split(",")))
                 curr_states[cid] = state
+                logged.add(cid)
 
                 state_totals, state_percentages = state_to_df(curr_time, curr_states[cid])
                 data_percents[cid].append(state_percentages)
@@ -270,6 +286,8 @@ try:
 
                 line_num += 1
             #for
+
+            repeat_unchanged(curr_time, curr_states, logged, data_percents, data_totals)
         #with
 
         try:
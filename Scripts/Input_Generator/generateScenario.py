@@ -11,13 +11,15 @@ import os
 
 if (len(sys.argv) < 2):
     print("\033[33mgenerateScenario -- Usage")
-    print(" \033[36m$ python3 generateScenario <area> <progress=Y>\033[33m")
+    print(" \033[36m$ python3 generateScenario <area> <progress=Y> <-compact>\033[33m")
     print(" where \033[3m<area>\033[0;33m is either \033[1mOttawa\033[0;33m OR \033[1mOntario\033[0;33m")
-    print(" and \033[3m<progress=Y>\033[0;33m is a toggle for the progress updates (it defaults to on and a 'N' turns them off\033[0m")
+    print(" and \033[3m<progress=Y>\033[0;33m is a toggle for the progress updates (it defaults to on and a 'N' turns them off")
+    print(" and \033[3m<-compact>\033[0;33m writes each cell as its differences from the default cell with the neighborhoods as a list of edges\033[0m")
     sys.exit(-1)
 #if
 
-no_progress = len(sys.argv) > 2 and sys.argv[2] == "-np"
+no_progress = "-np" in sys.argv[2:]
+compact     = "-compact" in sys.argv[2:]
 
 # Setup variables that handle the area
 input_dir          = str(sys.argv[1])
@@ -47,6 +49,65 @@ def get_boundary_length(gdf, id1):
     return g1.boundary.length
 #get_boundary_length
 
+def compact_scenario(template):
+    """
+    Rewrites a scenario so each cell only keeps the state fields that differ from the default cell
+    and the neighborhoods become a list of [cell, neighbor, correlation] edges under "edges".
+    The model fills in everything else from the default cell when it loads the scenario
+    """
+    default          = template["cells"]["default"]
+    default_state    = default["state"]
+    default_vicinity = list(default["neighborhood"].values())[0]
+
+    cells = OrderedDict()
+    edges = list()
+    for key, cell in template["cells"].items():
+        if key == "default":
+            cells[key] = cell
+            continue
+        #if
+
+        cells[key] = {"state": {field: value for field, value in cell["state"].items() if default_state.get(field) != value}}
+
+        for neighbor, vicinity in cell["neighborhood"].items():
+            if neighbor == key and vicinity == default_vicinity:
+                continue # Added back by the model
+
+            edge = [key, neighbor, vicinity["correlation"]]
+            if vicinity["infection_correction_factors"] != default_vicinity["infection_correction_factors"]:
+                edge.append({"infection_correction_factors": vicinity["infection_correction_factors"]})
+            edges.append(edge)
+        #for
+    #for
+
+    compacted = OrderedDict()
+    compacted["cells"] = cells
+    compacted["edges"] = edges
+    for key, value in template.items():
+        if key != "cells":
+            compacted[key] = value
+    return compacted
+#compact_scenario()
+
+def dumps_compact(scenario):
+    """
+    One line per cell and per edge, a compact scenario is mostly made of them
+    """
+    sections = list()
+    for key, value in scenario.items():
+        if key == "cells":
+            entries = ["        " + json.dumps(cell_id) + ": " + json.dumps(cell) for cell_id, cell in value.items()]
+            sections.append('    "cells": {\n' + ",\n".join(entries) + "\n    }")
+        elif key == "edges":
+            entries = ["        " + json.dumps(edge) for edge in value]
+            sections.append('    "edges": [\n' + ",\n".join(entries) + "\n    ]")
+        else:
+            sections.append("    " + json.dumps(key) + ": " + json.dumps(value))
+    #for
+
+    return "{\n" + ",\n".join(sections) + "\n}"
+#dumps_compact()
+
 df     = pd.read_csv(cadmium_dir + clean_csv)   # General information (id, population, area...)
 df_adj = pd.read_csv(cadmium_dir + adj_csv)     # Pair of adjacent territories
 gdf    = gpd.read_file(cadmium_dir + gpkg_file) # GeoDataFrame with the territories poligons
@@ -148,7 +209,12 @@ for key, value in adj_full.items():
 
 # Insert fields object at the end of the json for use with the GIS Webviewer V2
 template["fields"] = fields["fields"]
-adj_full_json = json.dumps(template, indent=4, sort_keys=False)  # Dictionary to string (with indentation=4 for better formatting)
+
+if compact:
+    adj_full_json = dumps_compact(compact_scenario(template))
+else:
+    adj_full_json = json.dumps(template, indent=4, sort_keys=False)  # Dictionary to string (with indentation=4 for better formatting)
+#if
 
 with open("output/scenario_"+input_dir+".json", "w") as f:
     f.write(adj_full_json)
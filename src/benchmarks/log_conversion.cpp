@@ -0,0 +1,146 @@
+/**
+ * Checks that convert-log (see main.cpp) turns the binary and change-only logs back into the
+ * text state log. A scenario is run with the lockstep engine, both through run_until() and a day
+ * at a time through step() as the region set does, writing the text, binary and change-only logs
+ * of the same run. The text log is expanded to every cell every day as convert-log expands it,
+ * and must be the same as both converted logs. Like the model it writes to ../logs. Exits with 1
+ * if they differ.
+ *
+ * Usage: log_conversion_test SCENARIO_CONFIG.json|SCENARIO_IMAGE [DAYS=50]
+*/
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include "../model/geographical_coupled.hpp"
+#include "../model/lockstep_runner.hpp"
+#include "../model/binary_state_log.hpp"
+
+using namespace std;
+
+using TIME = float;
+
+/**
+ * @brief Loads a scenario with its cells left out of Cadmium
+ *
+ * @param scenario Path to the scenario or its image
+ * @return geographical_coupled<TIME> With detached_cells and the graph set up
+*/
+geographical_coupled<TIME> load(string const& scenario)
+{
+    geographical_coupled<TIME> model("");
+    model.detached = true;
+
+    if (scenario_image::mapped::is_image(scenario))
+        model.add_cells_image(scenario);
+    else
+        model.add_cells_json(scenario);
+    model.couple_cells();
+    return model;
+}
+
+/**
+ * @brief Compares two logs line by line
+ *
+ * @param name Printed with the result
+ * @param expected Expanded text log
+ * @param got Converted log
+ * @return bool Whether they're the same
+*/
+bool same(string const& name, string const& expected, string const& got)
+{
+    istringstream e(expected), g(got);
+    string expected_line, got_line;
+    unsigned long line = 0;
+    while (true)
+    {
+        bool more_expected = (bool)getline(e, expected_line);
+        bool more_got      = (bool)getline(g, got_line);
+        ++line;
+
+        if (!more_expected && !more_got)
+        {
+            cout << name << ": same " << line - 1 << " lines\n";
+            return true;
+        }
+        if (more_expected != more_got || expected_line != got_line)
+        {
+            cout << name << ": differs from line " << line << "\n  expected: " << (more_expected ? expected_line : "(end)")
+                 << "\n  got:      " << (more_got ? got_line : "(end)") << "\n";
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief Runs a scenario writing the three logs and compares them
+ *
+ * @param scenario Path to the scenario or its image
+ * @param days Simulation time
+ * @param stepped Whether to step a day at a time instead of run_until()
+ * @return bool Whether the converted logs are the expanded text log
+*/
+bool check(string const& scenario, TIME days, bool stepped)
+{
+    string const binary_path = "../logs/log_conversion_test.bin";
+
+    ostringstream text, changes;
+    {
+        ofstream binary(binary_path, ios::binary);
+        if (!binary.is_open())
+            throw runtime_error{"Unable to open the file: " + binary_path};
+
+        geographical_coupled<TIME> model = load(scenario);
+        lockstep_runner<TIME> runner(model.detached_cells, model.graph, 1);
+        multi_log<TIME> logs({make_shared<state_log<TIME>>(text), make_shared<binary_state_log::writer<TIME>>(binary),
+                              make_shared<change_log<TIME>>(changes)});
+
+        if (stepped)
+        {
+            for (TIME day = 0; day < days; day += 1)
+                runner.step(day, &logs);
+            logs.flush();
+        }
+        else
+            runner.run_until(days, &logs);
+    }
+
+    // As convert-log writes the text log
+    istringstream written(text.str());
+    ostringstream expected;
+    expand_changes(written, expected);
+
+    binary_state_log::reader reader(binary_path);
+    ostringstream converted;
+    binary_state_log::write_text(reader, converted);
+    remove(binary_path.c_str());
+
+    istringstream changed(changes.str());
+    ostringstream expanded;
+    expand_changes(changed, expanded);
+
+    string const engine = stepped ? "step()       " : "run_until()  ";
+    bool binary_same  = same(engine + " binary", expected.str(), converted.str());
+    bool changes_same = same(engine + " changes", expected.str(), expanded.str());
+    return binary_same && changes_same;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: " << argv[0] << " SCENARIO_CONFIG.json|SCENARIO_IMAGE [DAYS=50]" << endl;
+        return 1;
+    }
+
+    string scenario = argv[1];
+    TIME days       = argc > 2 ? atof(argv[2]) : 50;
+
+    bool run_until = check(scenario, days, false);
+    bool stepped   = check(scenario, days, true);
+
+    return run_until && stepped ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/**
+ * Lines per second of the state log's <population,S,E,VD1,VD2,I,R,new_E,new_I,new_R,D> tuple
+ * inserted value by value into an ostream, as the state logger used to, against log_format's
+ * to_chars path (see model/cells/log_format.hpp). The streams discard what they're given so only
+ * the formatting is timed, and both paths are checked to write the same bytes.
+ *
+ * Usage: log_format_benchmark [LINES=1000000] [PRECISION=6]
+*/
+
+#include <array>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <streambuf>
+#include "../model/cells/log_format.hpp"
+
+using namespace std;
+
+using values = array<double, 11>;
+
+// Drops what's written, keeping a running hash of it to compare the outputs
+class discarding_buffer : public streambuf
+{
+    private:
+        char buffer[4096];
+
+        void consume()
+        {
+            for (char const* c = pbase(); c != pptr(); ++c)
+                hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+            setp(buffer, buffer + sizeof(buffer));
+        }
+
+    protected:
+        int_type overflow(int_type c) override
+        {
+            consume();
+            if (!traits_type::eq_int_type(c, traits_type::eof()))
+            {
+                *pptr() = traits_type::to_char_type(c);
+                pbump(1);
+            }
+            return traits_type::not_eof(c);
+        }
+
+        int sync() override
+        {
+            consume();
+            return 0;
+        }
+
+    public:
+        unsigned long long hash = 14695981039346656037ULL;
+
+        discarding_buffer() { setp(buffer, buffer + sizeof(buffer)); }
+};
+
+// Populations and proportions rounded to 4 decimals as a scenario's precision does, with the zeros of healthy cells
+vector<values> make_states(unsigned int lines)
+{
+    mt19937_64 random(2002);
+    uniform_real_distribution<double> proportion(0.0, 1.0);
+
+    vector<values> states(min(lines, 100000U));
+    for (values& v : states)
+    {
+        v[0] = floor(proportion(random) * 1000000);
+        for (unsigned int i = 1; i < v.size(); ++i)
+            v[i] = proportion(random) < 0.3 ? 0 : round(proportion(random) * 10000) / 10000;
+    }
+    return states;
+}
+
+/**
+ * @brief Times writing the states to a discarding stream
+ *
+ * @param name Printed with the timing
+ * @param states Written in turn until there were as many lines
+ * @param lines Lines to write
+ * @param precision Of the stream
+ * @param write Writes one state
+ * @return unsigned long long Hash of what was written
+*/
+template <typename WRITE>
+unsigned long long time_it(string const& name, vector<values> const& states, unsigned int lines, int precision, WRITE write)
+{
+    discarding_buffer buffer;
+    ostream os(&buffer);
+    os.precision(precision);
+
+    auto start = chrono::steady_clock::now();
+    for (unsigned int line = 0; line < lines; ++line)
+    {
+        write(os, states[line % states.size()]);
+        os << '\n';
+    }
+    os.flush();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << left << setw(10) << name << right << fixed << setprecision(0) << setw(12) << lines / seconds << " lines/s\n";
+    return buffer.hash;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int lines = argc > 1 ? atoi(argv[1]) : 1000000;
+    int precision      = argc > 2 ? atoi(argv[2]) : 6;
+
+    vector<values> states = make_states(lines);
+    cout << lines << " lines at a precision of " << precision << "\n";
+
+    unsigned long long inserted = time_it("ostream", states, lines, precision, [](ostream& os, values const& v) {
+        os << "<" << v[0];
+        for (unsigned int i = 1; i < v.size(); ++i)
+            os << "," << v[i];
+        os << ">";
+    });
+    unsigned long long formatted = time_it("to_chars", states, lines, precision, [](ostream& os, values const& v) {
+        log_format::write(os, v);
+    });
+
+    if (inserted != formatted)
+    {
+        cout << "The formatters don't write the same text\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * Throughput of a simulation with each -log mode (see model/log_modes.hpp). The scenario is
+ * loaded again for every mode and only the run is timed. Like the model it writes to ../logs
+ *
+ * Usage: log_modes_benchmark SCENARIO_CONFIG.json|SCENARIO_IMAGE [DAYS=50] [-engine=cadmium|lockstep|region-set] [-threads=N]
+*/
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include "../model/geographical_coupled.hpp"
+#include "../model/lockstep_runner.hpp"
+#include "../model/log_modes.hpp"
+#include "../model/binary_state_log.hpp"
+
+using namespace std;
+
+using TIME = float;
+
+/**
+ * @brief Runs a scenario the way main.cpp does with one log mode
+ *
+ * @param scenario Path to the scenario or its image
+ * @param days Simulation time
+ * @param engine cadmium, lockstep or region-set
+ * @param threads Threads of the lockstep and region-set engines
+ * @param logs Log mode
+ * @param cells Set to the number of cells in the scenario
+ * @return double Seconds the run took
+*/
+double run(string const& scenario, TIME days, string const& engine, unsigned int threads, log_mode logs, unsigned int& cells)
+{
+    bool lockstep      = engine == "lockstep";
+    bool as_region_set = engine == "region-set" || ((logs == log_mode::aggregates || logs == log_mode::binary || logs == log_mode::changes) && !lockstep);
+
+    log_files::open(logs);
+
+    geographical_coupled<TIME> model = geographical_coupled<TIME>("");
+
+    shared_ptr<cells_log<TIME>> day_log;
+    if (logs == log_mode::aggregates)
+        day_log = make_shared<aggregate_log<TIME>>(log_files::aggregates());
+    else if (logs == log_mode::binary)
+        day_log = make_shared<binary_state_log::writer<TIME>>(log_files::binary());
+    else if (logs == log_mode::changes)
+        day_log = make_shared<change_log<TIME>>(log_files::state());
+    else if (lockstep || as_region_set)
+    {
+        vector<shared_ptr<cells_log<TIME>>> text_logs;
+        if (logs == log_mode::all || logs == log_mode::states)
+            text_logs.push_back(make_shared<state_log<TIME>>(log_files::state(), model.get_id()));
+        if (logs == log_mode::all || logs == log_mode::messages)
+            text_logs.push_back(make_shared<message_log<TIME>>(log_files::messages(), model.get_id()));
+
+        if (text_logs.size() == 1)
+            day_log = text_logs.front();
+        else if (text_logs.size() > 1)
+            day_log = make_shared<multi_log<TIME>>(move(text_logs));
+    }
+
+    model.detached           = lockstep;
+    model.as_region_set      = as_region_set;
+    model.region_set_threads = threads;
+    model.region_set_log     = as_region_set ? day_log : nullptr;
+
+    if (scenario_image::mapped::is_image(scenario))
+        model.add_cells_image(scenario);
+    else
+        model.add_cells_json(scenario);
+    model.couple_cells();
+    cells = model.graph->num_cells();
+
+    auto start = chrono::steady_clock::now();
+    if (lockstep)
+    {
+        lockstep_runner<TIME> r(model.detached_cells, model.graph, threads);
+        r.run_until(days, day_log.get());
+    }
+    else
+    {
+        shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> top = make_shared<geographical_coupled<TIME>>(model);
+        run_cadmium(as_region_set ? log_mode::none : logs, top, days, false);
+        if (day_log)
+            day_log->flush();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // The next mode opens its own files
+    log_files::messages().close();
+    log_files::state().close();
+    log_files::aggregates().close();
+    log_files::binary().close();
+
+    return seconds;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: " << argv[0] << " SCENARIO_CONFIG.json|SCENARIO_IMAGE [DAYS=50] [-engine=cadmium|lockstep|region-set] [-threads=N]" << endl;
+        return 1;
+    }
+
+    string scenario      = argv[1];
+    TIME days            = argc > 2 ? atof(argv[2]) : 50;
+    string engine        = "cadmium";
+    unsigned int threads = thread::hardware_concurrency();
+    for (int i = 3; i < argc; ++i)
+    {
+        if (strncmp(argv[i], "-engine=", 8) == 0)
+            engine = argv[i] + 8;
+        else if (strncmp(argv[i], "-threads=", 9) == 0)
+            threads = atoi(argv[i] + 9);
+    }
+
+    cout << scenario << ", " << days << " days, " << engine << " engine\n";
+
+    pair<char const*, log_mode> const modes[] = { {"all", log_mode::all}, {"states", log_mode::states}, {"messages", log_mode::messages},
+                                                  {"aggregates", log_mode::aggregates}, {"binary", log_mode::binary},
+                                                  {"changes", log_mode::changes}, {"none", log_mode::none} };
+    for (auto const& mode : modes)
+    {
+        unsigned int cells = 0;
+        double seconds = run(scenario, days, engine, threads, mode.second, cells);
+
+        cout << left << setw(12) << mode.first << right << fixed << setprecision(3) << setw(9) << seconds << " s  "
+             << setprecision(0) << setw(12) << cells * days / seconds << " cell-days/s" << endl;
+    }
+
+    return 0;
+}
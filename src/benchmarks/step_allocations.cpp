@@ -0,0 +1,175 @@
+/**
+ * Checks that computing a day doesn't allocate once the cells are warmed up (see AgeDataWorkspace
+ * in model/cells/AgeData.hpp). The global operator new is replaced by one that counts, then every
+ * cell of a scenario is stepped for a few days to warm up and the allocations of the next days
+ * are counted, both through local_computation() as Cadmium calls it and through the lockstep
+ * engine's step(). Exits with 1 if anything was allocated.
+ *
+ * Usage: step_allocations_test SCENARIO_CONFIG.json|SCENARIO_IMAGE [DAYS=100] [WARM_UP=5]
+*/
+
+#include <new>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <unordered_map>
+#include "../model/geographical_coupled.hpp"
+#include "../model/lockstep_runner.hpp"
+
+using namespace std;
+
+using TIME = float;
+
+static atomic<bool> counting{false};
+static atomic<unsigned long> allocations{0};
+
+static void* allocate(size_t size)
+{
+    if (counting.load(memory_order_relaxed))
+        allocations.fetch_add(1, memory_order_relaxed);
+
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw bad_alloc();
+    return p;
+}
+
+static void* allocate(size_t size, align_val_t alignment)
+{
+    if (counting.load(memory_order_relaxed))
+        allocations.fetch_add(1, memory_order_relaxed);
+
+    // aligned_alloc wants a multiple of the alignment
+    size_t const a = static_cast<size_t>(alignment);
+    void* p = aligned_alloc(a, (size + a - 1) / a * a);
+    if (p == nullptr)
+        throw bad_alloc();
+    return p;
+}
+
+// The array and nothrow forms call these
+void* operator new(size_t size)                             { return allocate(size);            }
+void* operator new(size_t size, align_val_t alignment)      { return allocate(size, alignment); }
+void operator delete(void* p) noexcept                      { free(p); }
+void operator delete(void* p, size_t) noexcept              { free(p); }
+void operator delete(void* p, align_val_t) noexcept         { free(p); }
+void operator delete(void* p, size_t, align_val_t) noexcept { free(p); }
+
+/**
+ * @brief Loads a scenario with its cells left out of Cadmium
+ *
+ * @param scenario Path to the scenario or its image
+ * @return geographical_coupled<TIME> With detached_cells and the graph set up
+*/
+geographical_coupled<TIME> load(string const& scenario)
+{
+    geographical_coupled<TIME> model("");
+    model.detached = true;
+
+    if (scenario_image::mapped::is_image(scenario))
+        model.add_cells_image(scenario);
+    else
+        model.add_cells_json(scenario);
+    model.couple_cells();
+    return model;
+}
+
+/**
+ * @brief Allocations of the days computed with local_computation(). What Cadmium does around it
+ * is done here without allocating: a changed state replaces the cell's, then every cell's
+ * neighbors_state is given the states of the day
+ *
+ * @param scenario Path to the scenario or its image
+ * @param days Days counted
+ * @param warm_up Days stepped before counting
+ * @return unsigned long
+*/
+unsigned long count_local_computation(string const& scenario, unsigned int days, unsigned int warm_up)
+{
+    geographical_coupled<TIME> model = load(scenario);
+    vector<shared_ptr<geographical_cell<TIME>>> const& cells = model.detached_cells;
+
+    unordered_map<string, geographical_cell<TIME>*> by_id;
+    for (shared_ptr<geographical_cell<TIME>> const& cell : cells)
+        by_id[cell->cell_id] = cell.get();
+
+    vector<sevirds_message> next(cells.size());
+    auto share_states = [&]()
+    {
+        for (shared_ptr<geographical_cell<TIME>> const& cell : cells)
+            for (auto& neighbor : cell->state.neighbors_state)
+                neighbor.second = by_id.at(neighbor.first)->state.current_state;
+    };
+    share_states();
+
+    for (unsigned int day = 0; day < warm_up + days; ++day)
+    {
+        if (day == warm_up)
+            counting.store(true);
+
+        for (unsigned int i = 0; i < cells.size(); ++i)
+        {
+            cells[i]->simulation_clock = day;
+            next[i] = cells[i]->local_computation();
+        }
+
+        for (unsigned int i = 0; i < cells.size(); ++i)
+        {
+            if (next[i] != cells[i]->state.current_state)
+                cells[i]->state.current_state = next[i];
+            next[i] = sevirds_message();
+        }
+        share_states();
+    }
+
+    counting.store(false);
+    return allocations.exchange(0);
+}
+
+/**
+ * @brief Allocations of the days computed by the lockstep engine, on the calling thread only
+ *
+ * @param scenario Path to the scenario or its image
+ * @param days Days counted
+ * @param warm_up Days stepped before counting
+ * @return unsigned long
+*/
+unsigned long count_step(string const& scenario, unsigned int days, unsigned int warm_up)
+{
+    geographical_coupled<TIME> model = load(scenario);
+    lockstep_runner<TIME> runner(model.detached_cells, model.graph, 1);
+
+    for (unsigned int day = 0; day < warm_up + days; ++day)
+    {
+        if (day == warm_up)
+            counting.store(true);
+        runner.step(day);
+    }
+
+    counting.store(false);
+    return allocations.exchange(0);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: " << argv[0] << " SCENARIO_CONFIG.json|SCENARIO_IMAGE [DAYS=100] [WARM_UP=5]" << endl;
+        return 1;
+    }
+
+    string scenario       = argv[1];
+    unsigned int days     = argc > 2 ? atoi(argv[2]) : 100;
+    unsigned int warm_up  = argc > 3 ? atoi(argv[3]) : 5;
+
+    unsigned long local_computation = count_local_computation(scenario, days, warm_up);
+    unsigned long step              = count_step(scenario, days, warm_up);
+
+    cout << days << " days after " << warm_up << " to warm up\n"
+         << "local_computation(): " << local_computation << " allocations\n"
+         << "step():              " << step << " allocations" << endl;
+
+    return local_computation == 0 && step == 0 ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+/**
+ * Microbenchmark of the infectiousness sum of geographical_cell::publish():
+ * the nested-vector loop it used to run against the fused μ(n) * λ(n) weights
+ * with each of the transmission kernels.
+ *
+ * Usage: transmission_kernels_benchmark [INFECTED_DAYS=12] [AGE_GROUPS=5]
+*/
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include "../model/cells/rate_tables.hpp"
+#include "../model/cells/transmission_kernels.hpp"
+
+using namespace std;
+
+// The rates of a cell and the three infected vectors of a state, one row per age group
+struct workload
+{
+    rate_tables rates;
+    vector<vector<double>> infected, infectedD1, infectedD2;
+};
+
+workload make_workload(unsigned int age_groups, unsigned int days)
+{
+    mt19937_64 random(2002);
+    uniform_real_distribution<double> proportion(0.0, 1.0);
+
+    workload w;
+    for (unsigned int a = 0; a < age_groups; ++a)
+    {
+        w.rates.mobility_rates.emplace_back();
+        w.rates.virulence_rates.emplace_back();
+        w.infected.emplace_back();
+        w.infectedD1.emplace_back();
+        w.infectedD2.emplace_back();
+        for (unsigned int n = 0; n < days; ++n)
+        {
+            w.rates.mobility_rates.back().push_back(proportion(random));
+            w.rates.virulence_rates.back().push_back(proportion(random));
+            w.infected.back().push_back(proportion(random) / days);
+            w.infectedD1.back().push_back(proportion(random) / days);
+            w.infectedD2.back().push_back(proportion(random) / days);
+        }
+    }
+
+    w.rates.fuse();
+    return w;
+}
+
+// The loop publish() ran before the weights were fused
+double nested_loop(workload const& w)
+{
+    rate_tables::phase_rates const& mobility_rates  = w.rates.mobility_rates;
+    rate_tables::phase_rates const& virulence_rates = w.rates.virulence_rates;
+
+    double sum = 0;
+    for (unsigned int a = 0; a < w.infected.size(); ++a)
+    {
+        for (unsigned int n = 0; n < w.infected[a].size(); ++n)
+            sum += mobility_rates.at(a).at(n) * virulence_rates.at(a).at(n) * w.infected[a][n];
+        for (unsigned int n = 0; n < w.infectedD1[a].size(); ++n)
+            sum += mobility_rates.at(a).at(n) * virulence_rates.at(a).at(n) * w.infectedD1[a][n];
+        for (unsigned int n = 0; n < w.infectedD2[a].size(); ++n)
+            sum += mobility_rates.at(a).at(n) * virulence_rates.at(a).at(n) * w.infectedD2[a][n];
+    }
+    return sum;
+}
+
+double fused(workload const& w, transmission_kernels::kernel dot)
+{
+    double sum = 0;
+    for (unsigned int a = 0; a < w.infected.size(); ++a)
+    {
+        const_phase_view weights = w.rates.transmission_weights(a);
+        sum += dot(weights.data(), w.infected[a].data(),   w.infected[a].size());
+        sum += dot(weights.data(), w.infectedD1[a].data(), w.infectedD1[a].size());
+        sum += dot(weights.data(), w.infectedD2[a].data(), w.infectedD2[a].size());
+    }
+    return sum;
+}
+
+/**
+ * @brief Times a sum over the workload
+ *
+ * @param name Printed with the timing
+ * @param w Rates and states
+ * @param sum Function being timed
+ * @return double Result of the last run
+*/
+template <typename SUM>
+double time_it(string const& name, workload const& w, SUM sum)
+{
+    constexpr unsigned int RUNS = 1000000;
+
+    // volatile so the runs aren't folded into one
+    volatile double result = 0;
+    auto start = chrono::steady_clock::now();
+    for (unsigned int run = 0; run < RUNS; ++run)
+        result = sum(w);
+    auto elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+
+    cout << left << setw(10) << name << right << setw(10) << fixed << setprecision(1) << elapsed / RUNS
+         << " ns per state  " << setprecision(17) << result << '\n';
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int days       = argc > 1 ? atoi(argv[1]) : 12;
+    unsigned int age_groups = argc > 2 ? atoi(argv[2]) : 5;
+
+    workload w = make_workload(age_groups, days);
+
+    string best;
+    transmission_kernels::best(&best);
+    cout << age_groups << " age groups, " << days << " infected days, the model uses the " << best << " kernel\n";
+
+    time_it("nested", w, nested_loop);
+    double scalar = time_it("scalar", w, [](workload const& w) { return fused(w, transmission_kernels::dot_scalar); });
+
+    bool same = true;
+#if PANDEMIC_X86_KERNELS
+    same &= time_it("sse2", w, [](workload const& w) { return fused(w, transmission_kernels::dot_sse2); }) == scalar;
+    if (__builtin_cpu_supports("avx2"))
+        same &= time_it("avx2", w, [](workload const& w) { return fused(w, transmission_kernels::dot_avx2); }) == scalar;
+#endif
+
+    if (!same)
+    {
+        cout << "The kernels don't add up to the same result\n";
+        return 1;
+    }
+    return 0;
+}
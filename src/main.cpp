@@ -30,9 +30,10 @@
 
 #include <fstream>
 #include <cadmium/modeling/dynamic_coupled.hpp>
-#include <cadmium/engine/pdevs_dynamic_runner.hpp>
-#include <cadmium/logger/common_loggers.hpp>
 #include "model/geographical_coupled.hpp"
+#include "model/lockstep_runner.hpp"
+#include "model/log_modes.hpp"
+#include "model/binary_state_log.hpp"
 #include <thread>
 #include <chrono>
 
@@ -42,27 +43,71 @@ using namespace cadmium::celldevs;
 
 using TIME = float;
 
-/*************** Loggers *******************/
-static ofstream out_messages("../logs/pandemic_messages.txt");
-struct oss_sink_messages { static ostream& sink(){ return out_messages; } };
-static ofstream out_state("../logs/pandemic_state.txt");
-struct oss_sink_state { static ostream& sink() { return out_state; } };
-
-using state             = logger::logger<logger::logger_state,          dynamic::logger::formatter<TIME>,   oss_sink_state>;
-using log_messages      = logger::logger<logger::logger_messages,       dynamic::logger::formatter<TIME>,   oss_sink_messages>;
-using global_time_mes   = logger::logger<logger::logger_global_time,    dynamic::logger::formatter<TIME>,   oss_sink_messages>;
-using global_time_sta   = logger::logger<logger::logger_global_time,    dynamic::logger::formatter<TIME>,   oss_sink_state>;
-using logger_top        = logger::multilogger<state,                    log_messages,                       global_time_mes, global_time_sta>;
-
 int main(int argc, char** argv)
 {
     if (argc < 2)
     {
         cerr << "\033[31mProgram used with wrong parameters. The program must be invoked as follows: "
-            << argv[0] << " SCENARIO_CONFIG.json [MAX_SIMULATION_TIME (default: 500)]\33[0m" << endl;
+            << argv[0] << " SCENARIO_CONFIG.json|SCENARIO_IMAGE [MAX_SIMULATION_TIME (default: 500)] [-np] [-engine=cadmium|lockstep|region-set] [-parallel] [-threads=N]"
+            << " [-log=all|states|messages|aggregates|binary|changes|none]\n"
+            << "or, to compile a scenario into an image that starts faster: "
+            << argv[0] << " compile-scenario SCENARIO_CONFIG.json SCENARIO_IMAGE\n"
+            << "or, to write a binary or change-only state log as the full text log: "
+            << argv[0] << " convert-log STATE_LOG TEXT_LOG\33[0m" << endl;
         throw;
     }
 
+    // Reads and validates the scenario once and saves it as an image (see model/scenario_image.hpp)
+    if (strcmp(argv[1], "compile-scenario") == 0)
+    {
+        if (argc < 4)
+        {
+            cerr << "\033[31mThe scenario and the image to write must be given: "
+                << argv[0] << " compile-scenario SCENARIO_CONFIG.json SCENARIO_IMAGE\33[0m" << endl;
+            return 1;
+        }
+
+        geographical_coupled<TIME> compiler = geographical_coupled<TIME>("");
+        unsigned int cells = compiler.compile_scenario(argv[2], argv[3]);
+        cout << "\033[1;32mCompiled " << cells << " cells into " << argv[3] << "\033[0m" << endl;
+        return 0;
+    }
+
+    // Writes a log of -log=binary or -log=changes as a text state log with every cell every day
+    // (see model/binary_state_log.hpp and model/cells_log.hpp)
+    if (strcmp(argv[1], "convert-log") == 0)
+    {
+        if (argc < 4)
+        {
+            cerr << "\033[31mThe state log and the text log to write must be given: "
+                << argv[0] << " convert-log STATE_LOG TEXT_LOG\33[0m" << endl;
+            return 1;
+        }
+
+        ifstream changes;
+        if (!binary_state_log::is_log(argv[2]))
+        {
+            changes.open(argv[2]);
+            if (!changes.is_open())
+                throw runtime_error{"Unable to open the log: " + string{argv[2]}};
+        }
+
+        ofstream text(argv[3]);
+        if (!text.is_open())
+            throw runtime_error{"Unable to open the file: " + string{argv[3]}};
+
+        uint64_t days;
+        if (changes.is_open())
+            days = expand_changes(changes, text);
+        else
+        {
+            binary_state_log::reader log(argv[2]);
+            days = binary_state_log::write_text(log, text);
+        }
+        cout << "\033[1;32mWrote " << days << " days into " << argv[3] << "\033[0m" << endl;
+        return 0;
+    }
+
     // The C++ standard filesystem library is not used as it may require an additional linker flag (-std=c++17),
     // but more importantly that in certain versions of GCC the filesystem is contained in an experimental folder (GCC 7).
     // Newer versions of GCC doesn't have this problem (apparently GCC 8+ ?). As a result, depending on the version of GCC
@@ -78,25 +123,114 @@ int main(int argc, char** argv)
     // Note: At the time of this writing, the web viewer that consumes the log files of this simulator relies on the
     // the input to geographical_coupled parameter (param name: id) to be empty; this changes how the IDs of cells
     // in the log files are printed.
+    // Optional flags after the simulation time
+    bool noProgress    = false;         // -np: no progress meter
+    bool lockstep      = false;         // -engine=lockstep: step the cells with lockstep_runner instead of Cadmium
+    bool as_region_set = false;         // -engine=region-set: step the cells inside one Cadmium model
+    bool parallel      = false;         // -parallel: compute Cadmium's transitions ahead on a pool of threads
+    unsigned int threads = thread::hardware_concurrency(); // -threads=N: threads of the lockstep and region-set engines or of -parallel
+    log_mode logs        = log_mode::all; // -log=MODE: which logs are written (see model/log_modes.hpp)
+    for (int i = 3; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-np") == 0)
+            noProgress = true;
+        else if (strncmp(argv[i], "-engine=", 8) == 0)
+        {
+            lockstep      = strcmp(argv[i], "-engine=lockstep") == 0;
+            as_region_set = strcmp(argv[i], "-engine=region-set") == 0;
+            if (!lockstep && !as_region_set && strcmp(argv[i], "-engine=cadmium") != 0)
+                cerr << "\033[33mUnknown engine, using Cadmium: " << argv[i] << "\033[0m" << endl;
+        }
+        else if (strcmp(argv[i], "-parallel") == 0)
+            parallel = true;
+        else if (strncmp(argv[i], "-threads=", 9) == 0)
+            threads = atoi(argv[i] + 9);
+        else if (strncmp(argv[i], "-log=", 5) == 0)
+        {
+            if (!parse_log_mode(argv[i] + 5, logs))
+                cerr << "\033[33mUnknown log mode, writing every log: " << argv[i] << "\033[0m" << endl;
+        }
+        else
+            cerr << "\033[33mIgnoring unknown flag: " << argv[i] << "\033[0m" << endl;
+    }
+
+    // Cadmium's loggers see one cell at a time, so the cells are run as a region set that adds them up
+    // or compares them instead. The results are the same (see model/region_set.hpp)
+    if ((logs == log_mode::aggregates || logs == log_mode::binary || logs == log_mode::changes) && !lockstep && !as_region_set)
+    {
+        cerr << "\033[33mThe aggregates, binary and changes logs are written by the region-set engine, using it instead of Cadmium\033[0m" << endl;
+        as_region_set = true;
+    }
+    if (parallel && (lockstep || as_region_set))
+        cerr << "\033[33mIgnoring -parallel, the " << (lockstep ? "lockstep" : "region-set") << " engine already steps the cells on -threads="
+             << threads << "\033[0m" << endl;
+
+    log_files::open(logs);
+
     geographical_coupled<TIME> test = geographical_coupled<TIME>("");
+
+    // Where the engines that step the cells themselves write each day (see model/cells_log.hpp)
+    shared_ptr<cells_log<TIME>> day_log;
+    if (logs == log_mode::aggregates)
+        day_log = make_shared<aggregate_log<TIME>>(log_files::aggregates());
+    else if (logs == log_mode::binary)
+        day_log = make_shared<binary_state_log::writer<TIME>>(log_files::binary());
+    else if (logs == log_mode::changes)
+        day_log = make_shared<change_log<TIME>>(log_files::state());
+    else if (lockstep || as_region_set)
+    {
+        // The state and message logs as Cadmium writes them
+        vector<shared_ptr<cells_log<TIME>>> text_logs;
+        if (logs == log_mode::all || logs == log_mode::states)
+            text_logs.push_back(make_shared<state_log<TIME>>(log_files::state(), test.get_id()));
+        if (logs == log_mode::all || logs == log_mode::messages)
+            text_logs.push_back(make_shared<message_log<TIME>>(log_files::messages(), test.get_id()));
+
+        if (text_logs.size() == 1)
+            day_log = text_logs.front();
+        else if (text_logs.size() > 1)
+            day_log = make_shared<multi_log<TIME>>(move(text_logs));
+    }
+
+    test.detached           = lockstep;
+    test.as_region_set      = as_region_set; // See model/region_set.hpp
+    test.region_set_threads = threads;
+    test.region_set_log     = as_region_set ? day_log : nullptr;
+    if (parallel && !lockstep && !as_region_set)
+        test.transitions = make_shared<parallel_transitions<TIME>>(threads); // See model/cells/parallel_transitions.hpp
+
     string scenario_config_file_path = argv[1];
-    test.add_cells_json(scenario_config_file_path);
+    if (scenario_image::mapped::is_image(scenario_config_file_path))
+        test.add_cells_image(scenario_config_file_path);
+    else
+        test.add_cells_json(scenario_config_file_path);
     test.couple_cells();
 
-    shared_ptr<cadmium::dynamic::modeling::coupled <TIME>>
-    t = make_shared<geographical_coupled<TIME>>(test);
+    float sim_time = (argc > 2) ? atof(argv[2]) : 500;
 
-    // Has the 'no progress' flag been set?
-    bool noProgress = (argc > 3) && strcmp((argv[3]), "-np") == 0;
+    if (lockstep)
+    {
+        // Every cell steps once a day so they can all be computed at the same time,
+        // the days are logged the way Cadmium logs them (see model/lockstep_runner.hpp)
+        lockstep_runner<TIME> r(test.detached_cells, test.graph, threads);
+
+        if (!noProgress)
+            r.turn_progress_on();
 
-    cadmium::dynamic::engine::runner<TIME, logger_top> r(t, {0});
+        r.run_until(sim_time, day_log.get());
+    }
+    else
+    {
+        shared_ptr<cadmium::dynamic::modeling::coupled <TIME>>
+        t = make_shared<geographical_coupled<TIME>>(test);
 
-    // Turn on the progress meter
-    if (!noProgress)
-        r.turn_progress_on();
+        // The loggers of the mode are compiled in, the others cost nothing.
+        // A region set writes its own logs (see model/region_set.hpp)
+        run_cadmium(as_region_set ? log_mode::none : logs, t, sim_time, !noProgress);
 
-    float sim_time = (argc > 2) ? atof(argv[2]) : 500;
-    r.run_until(sim_time);
+        if (day_log)
+            day_log->flush();
+    }
 
     // The spaces at the the end are necessary to clear the terminal
     // line that's being overwritten
@@ -0,0 +1,282 @@
+#ifndef PANDEMIC_HOYA_2002_ASYNC_LOG_HPP
+#define PANDEMIC_HOYA_2002_ASYNC_LOG_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <csignal>
+#include <cstring>
+#include <ostream>
+#include <streambuf>
+
+using namespace std;
+
+/**
+ * A log file that is written by its own thread so the simulation never waits on the disk
+ * (see log_modes.hpp). What's logged is formatted straight into one of a ring of large aligned
+ * buffers; a full buffer is passed to the writer thread, which writes it in one call while the
+ * next one is filled. The ring has a single producer (the thread logging) and a single
+ * consumer (the writer) so they only share two counters.
+ *
+ * A flush doesn't pass the buffer on, Cadmium's loggers flush after every line. Everything is
+ * written when the file is closed, which happens on exit. If the program aborts, the buffers
+ * already passed to the writer are still written, the one being filled is lost.
+*/
+class async_log_buffer : public streambuf
+{
+    public:
+        static constexpr size_t BUFFER_SIZE = 1 << 20;
+        static constexpr size_t NUM_BUFFERS = 4;
+        static constexpr size_t ALIGNMENT   = 4096;
+
+    private:
+        struct slot
+        {
+            char* data  = nullptr;
+            size_t size = 0; // Bytes to write, set before the slot is handed over
+        };
+
+        array<slot, NUM_BUFFERS> ring;
+        atomic<size_t> head{0}; // Buffers handed over, the producer fills ring[head % NUM_BUFFERS]
+        atomic<size_t> tail{0}; // Buffers written
+        atomic<bool> stopping{false};
+        atomic<bool> failed{false};
+        FILE* file = nullptr;
+        thread writer;
+
+        // Sleeps a little longer the longer the other side keeps us waiting, so a waiting thread doesn't take a core
+        static void back_off(unsigned int& waits)
+        {
+            if (++waits < 64)
+                this_thread::yield();
+            else
+                this_thread::sleep_for(chrono::microseconds(waits < 1024 ? 50 : 500));
+        }
+
+        void write_buffers()
+        {
+            size_t written = tail.load(memory_order_relaxed);
+            unsigned int waits = 0;
+            while (true)
+            {
+                if (written == head.load(memory_order_acquire))
+                {
+                    // stopping is set after the last hand over
+                    if (stopping.load(memory_order_acquire) && written == head.load(memory_order_acquire))
+                        break;
+                    back_off(waits);
+                    continue;
+                }
+                waits = 0;
+
+                slot const& s = ring[written % NUM_BUFFERS];
+                if (fwrite(s.data, 1, s.size, file) != s.size)
+                    failed.store(true, memory_order_relaxed);
+                tail.store(++written, memory_order_release);
+            }
+        }
+
+        // Hands the buffer being filled to the writer and waits for a free one
+        void hand_over()
+        {
+            size_t const filling = head.load(memory_order_relaxed);
+            ring[filling % NUM_BUFFERS].size = pptr() - pbase();
+            head.store(filling + 1, memory_order_release);
+
+            unsigned int waits = 0;
+            while (filling + 1 - tail.load(memory_order_acquire) >= NUM_BUFFERS)
+                back_off(waits);
+
+            char* next = ring[(filling + 1) % NUM_BUFFERS].data;
+            setp(next, next + BUFFER_SIZE);
+        }
+
+        // The files the abort handler waits for
+        static array<atomic<async_log_buffer*>, 8>& open_buffers()
+        {
+            static array<atomic<async_log_buffer*>, 8> buffers{};
+            return buffers;
+        }
+
+        // The SIGABRT handler there was before on_abort(), it's raised once the logs are written
+        using signal_handler = void (*)(int);
+        static signal_handler& previous_abort_handler()
+        {
+            static signal_handler handler = SIG_DFL;
+            return handler;
+        }
+
+        /**
+         * Lets the writer threads finish the buffers they were given before the program goes down.
+         * The buffers being filled belong to the threads logging, which may be the ones aborting,
+         * so they're left alone. The files aren't buffered by stdio, there's nothing to flush.
+         * A writer thread that aborts itself isn't waited for, a stuck one only for a second and a half.
+        */
+        static void on_abort(int signal)
+        {
+            for (atomic<async_log_buffer*>& open : open_buffers())
+            {
+                async_log_buffer* buffer = open.exchange(nullptr);
+                if (buffer == nullptr || buffer->writer.get_id() == this_thread::get_id())
+                    continue;
+
+                size_t const handed_over = buffer->head.load(memory_order_acquire);
+                unsigned int waits = 0;
+                while (buffer->tail.load(memory_order_acquire) < handed_over && waits < 4096)
+                    back_off(waits);
+            }
+
+            signal_handler previous = previous_abort_handler();
+            std::signal(signal, previous == SIG_ERR || previous == on_abort ? SIG_DFL : previous);
+            std::raise(signal);
+        }
+
+    protected:
+        int_type overflow(int_type c) override
+        {
+            if (file == nullptr)
+                return traits_type::eof();
+
+            hand_over();
+            if (!traits_type::eq_int_type(c, traits_type::eof()))
+            {
+                *pptr() = traits_type::to_char_type(c);
+                pbump(1);
+            }
+            return traits_type::not_eof(c);
+        }
+
+        streamsize xsputn(char const* s, streamsize n) override
+        {
+            if (file == nullptr)
+                return 0;
+
+            streamsize left = n;
+            while (left > 0)
+            {
+                if (pptr() == epptr())
+                    hand_over();
+
+                streamsize chunk = min<streamsize>(left, epptr() - pptr());
+                memcpy(pptr(), s, chunk);
+                pbump(chunk);
+                s    += chunk;
+                left -= chunk;
+            }
+            return n;
+        }
+
+    public:
+        async_log_buffer()
+        {
+            for (slot& s : ring)
+                s.data = static_cast<char*>(::operator new(BUFFER_SIZE, align_val_t{ALIGNMENT}));
+        }
+
+        ~async_log_buffer() override
+        {
+            close();
+            for (slot& s : ring)
+                ::operator delete(s.data, align_val_t{ALIGNMENT});
+        }
+
+        async_log_buffer(async_log_buffer const&) = delete;
+        async_log_buffer& operator=(async_log_buffer const&) = delete;
+
+        /**
+         * @brief Opens (and empties) a file and starts its writer thread
+         *
+         * @param path File to write
+         * @return bool Whether the file could be opened
+        */
+        bool open(string const& path)
+        {
+            close();
+
+            file = fopen(path.c_str(), "wb");
+            if (file == nullptr)
+                return false;
+
+            // The buffers are already as large as the writes can be
+            setvbuf(file, nullptr, _IONBF, 0);
+
+            head.store(0);
+            tail.store(0);
+            stopping.store(false);
+            failed.store(false);
+            setp(ring[0].data, ring[0].data + BUFFER_SIZE);
+            writer = thread(&async_log_buffer::write_buffers, this);
+
+            static bool const handler_installed = (previous_abort_handler() = std::signal(SIGABRT, on_abort), true);
+            (void)handler_installed;
+            for (atomic<async_log_buffer*>& open : open_buffers())
+            {
+                async_log_buffer* expected = nullptr;
+                if (open.compare_exchange_strong(expected, this))
+                    break;
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief Writes everything logged and closes the file
+         *
+         * @return bool Whether everything could be written
+        */
+        bool close()
+        {
+            if (file == nullptr)
+                return true;
+
+            for (atomic<async_log_buffer*>& open : open_buffers())
+            {
+                async_log_buffer* expected = this;
+                open.compare_exchange_strong(expected, nullptr);
+            }
+
+            if (pptr() != pbase())
+                hand_over();
+            stopping.store(true, memory_order_release);
+            writer.join();
+
+            bool ok = !failed.load() && fclose(file) == 0;
+            file = nullptr;
+            setp(nullptr, nullptr);
+            return ok;
+        }
+
+        bool is_open() const { return file != nullptr; }
+};
+
+/**
+ * An ostream that writes to a file through an async_log_buffer
+*/
+class async_log_file : public ostream
+{
+    private:
+        async_log_buffer buffer;
+
+    public:
+        async_log_file() : ostream(nullptr) { rdbuf(&buffer); }
+
+        void open(string const& path)
+        {
+            clear();
+            if (!buffer.open(path))
+                setstate(ios::failbit);
+        }
+
+        void close()
+        {
+            if (!buffer.close())
+                setstate(ios::badbit);
+        }
+
+        bool is_open() const { return buffer.is_open(); }
+};
+
+#endif //PANDEMIC_HOYA_2002_ASYNC_LOG_HPP
@@ -0,0 +1,347 @@
+#ifndef PANDEMIC_HOYA_2002_BINARY_STATE_LOG_HPP
+#define PANDEMIC_HOYA_2002_BINARY_STATE_LOG_HPP
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include "cells_log.hpp"
+
+using namespace std;
+
+/**
+ * The state log as binary columns instead of text (-log=binary, see log_modes.hpp). Every cell
+ * takes the same 11 values a day as in the text log, so nothing has to be formatted while
+ * running and nothing has to be parsed to read it back:
+ *
+ *  - header;
+ *  - the schema, one field_record per value of a state (sevirds::log_values());
+ *  - the cell ids in log order: num_cells + 1 uint32_t offsets, then the characters;
+ *  - zero padding up to a multiple of 8 bytes;
+ *  - one block per time of the text log, the first states and then the states after each day:
+ *    the time as a double, then one column per field with the value of every cell in log order.
+ *    Every block has the same size so a day can be read without the others.
+ *
+ * Like a scenario image the log is meant to be read on a machine with the same byte order,
+ * which the header records. "convert-log" (see main.cpp) turns it back into the text log.
+*/
+namespace binary_state_log
+{
+    constexpr char MAGIC[8]            = {'P', 'A', 'N', 'D', 'L', 'O', 'G', '\0'};
+    constexpr uint32_t VERSION         = 1;
+    constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    enum field_type : uint32_t { FLOAT32 = 4, FLOAT64 = 8 }; // Bytes of a value
+
+    struct header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t num_cells;
+        uint32_t num_fields;
+        uint64_t ids_size; // Bytes of the characters of the cell ids
+    };
+
+    struct field_record
+    {
+        char name[16];   // Null terminated
+        uint32_t type;   // field_type
+        uint32_t padding;
+    };
+
+    // The fields of sevirds::log_values(), the columns of the text log
+    constexpr array<char const*, sevirds::NUM_LOG_VALUES> FIELD_NAMES = {"population", "S", "E", "VD1", "VD2", "I", "R",
+                                                                          "new_E", "new_I", "new_R", "D"};
+
+    /**
+     * Writes the states of every cell for each time of the state log (see state_log in
+     * cells_log.hpp): the first states, then after each day's transitions the states the cells
+     * moved to, labelled with the day that was computed. The header is written with the first
+     * states as that's when the cells are known.
+    */
+    template <typename T>
+    class writer : public cells_log<T>
+    {
+        private:
+            ostream& out;
+            bool started = false;
+            field_type type;
+            vector<char> block; // One day, reused
+
+            void write_header(vector<geographical_cell<T>*> const& cells)
+            {
+                vector<uint32_t> offsets(1, 0);
+                string ids;
+                for (geographical_cell<T> const* cell : cells)
+                {
+                    ids += cell->cell_id;
+                    offsets.push_back(ids.size());
+                }
+
+                header h{};
+                memcpy(h.magic, MAGIC, sizeof(MAGIC));
+                h.version    = VERSION;
+                h.byte_order = BYTE_ORDER_MARK;
+                h.num_cells  = cells.size();
+                h.num_fields = FIELD_NAMES.size();
+                h.ids_size   = ids.size();
+                out.write(reinterpret_cast<char const*>(&h), sizeof(h));
+
+                for (char const* name : FIELD_NAMES)
+                {
+                    field_record field{};
+                    strncpy(field.name, name, sizeof(field.name) - 1);
+                    field.type = type;
+                    out.write(reinterpret_cast<char const*>(&field), sizeof(field));
+                }
+
+                out.write(reinterpret_cast<char const*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+                out.write(ids.data(), ids.size());
+
+                // Counted rather than asked to the stream, log files can't tell where they are (see async_log.hpp)
+                uint64_t const written = sizeof(h) + FIELD_NAMES.size() * sizeof(field_record) + offsets.size() * sizeof(uint32_t) + ids.size();
+                static char const zeros[8] = {};
+                out.write(zeros, (8 - written % 8) % 8);
+
+                block.assign(sizeof(double) + FIELD_NAMES.size() * cells.size() * type, 0);
+            }
+
+            // One block with the states of every cell
+            void write_block(T time, vector<geographical_cell<T>*> const& cells)
+            {
+                unsigned int const num_cells = cells.size();
+                double const day = time;
+                memcpy(block.data(), &day, sizeof(double));
+
+                char* columns = block.data() + sizeof(double);
+                for (unsigned int i = 0; i < num_cells; ++i)
+                {
+                    array<double, sevirds::NUM_LOG_VALUES> const values = cells[i]->buffered_state().log_values();
+                    for (unsigned int f = 0; f < values.size(); ++f)
+                    {
+                        char* value = columns + (f * num_cells + i) * type;
+                        if (type == FLOAT64)
+                            memcpy(value, &values[f], sizeof(double));
+                        else
+                        {
+                            float const single = values[f];
+                            memcpy(value, &single, sizeof(float));
+                        }
+                    }
+                }
+
+                out.write(block.data(), block.size());
+            }
+
+        public:
+            /**
+             * @param out Log file, opened as binary
+             * @param type Of the values. FLOAT32 takes half the space, but the sixth digit of the
+             * converted log is sometimes off by one; with FLOAT64 it's the same as the text log
+            */
+            explicit writer(ostream& out, field_type type = FLOAT64) : out(out), type(type) { }
+
+            void log(T time, vector<geographical_cell<T>*> const& cells, vector<unsigned char> const& changed) override
+            {
+                if (started)
+                    return;
+
+                write_header(cells);
+                write_block(time, cells);
+                started = true;
+            }
+
+            void transitions(T time, vector<geographical_cell<T>*> const& cells, vector<unsigned char> const& transitioned) override
+            {
+                // Like the state log, a day on which no cell transitioned has no block
+                if (find(transitioned.begin(), transitioned.end(), 1) != transitioned.end())
+                    write_block(time, cells);
+            }
+
+            void flush() override { out.flush(); }
+    };
+
+    /**
+     * @brief Whether a file starts as a binary state log
+     *
+     * @param path File to check
+     * @return bool
+    */
+    bool is_log(string const& path)
+    {
+        ifstream in(path, ios::binary);
+        char magic[sizeof(MAGIC)] = {};
+        return in.read(magic, sizeof(magic)) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    }
+
+    // The states of every cell on a day, as read by reader
+    struct day
+    {
+        double time = 0;
+        vector<vector<double>> columns; // Field -> cell in log order
+
+        double value(unsigned int field, unsigned int cell) const { return columns[field][cell]; }
+    };
+
+    /**
+     * Reads a binary state log one day at a time.
+    */
+    class reader
+    {
+        private:
+            ifstream in;
+            vector<string> ids;
+            vector<string> field_names;
+            vector<uint32_t> field_types;
+            uint64_t data_start = 0; // First day
+            uint64_t block_size = 0; // Bytes of a day
+            uint64_t days       = 0;
+            vector<char> block;
+
+        public:
+            /**
+             * @param path Binary state log
+            */
+            explicit reader(string const& path) : in(path, ios::binary)
+            {
+                if (!in)
+                    throw runtime_error{"Unable to open the log: " + path};
+
+                header h{};
+                if (!in.read(reinterpret_cast<char*>(&h), sizeof(h)) || memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0)
+                    throw runtime_error{path + " is not a binary state log"};
+                if (h.version != VERSION || h.byte_order != BYTE_ORDER_MARK)
+                    throw runtime_error{path + " was written by another version of the model or on another kind of machine"};
+
+                block_size = sizeof(double);
+                for (uint32_t f = 0; f < h.num_fields; ++f)
+                {
+                    field_record field{};
+                    in.read(reinterpret_cast<char*>(&field), sizeof(field));
+                    if (field.type != FLOAT32 && field.type != FLOAT64)
+                        throw runtime_error{path + " has a field of an unknown type"};
+
+                    field.name[sizeof(field.name) - 1] = '\0';
+                    field_names.push_back(field.name);
+                    field_types.push_back(field.type);
+                    block_size += (uint64_t)field.type * h.num_cells;
+                }
+
+                vector<uint32_t> offsets(h.num_cells + 1);
+                string characters(h.ids_size, '\0');
+                in.read(reinterpret_cast<char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+                in.read(&characters[0], characters.size());
+                if (!in)
+                    throw runtime_error{path + " is cut short"};
+
+                for (uint32_t i = 0; i < h.num_cells; ++i)
+                    ids.push_back(characters.substr(offsets[i], offsets[i + 1] - offsets[i]));
+
+                data_start = in.tellg();
+                data_start += (8 - data_start % 8) % 8;
+
+                in.seekg(0, ios::end);
+                uint64_t file_size = in.tellg();
+                days = file_size > data_start ? (file_size - data_start) / block_size : 0;
+                in.seekg(data_start);
+            }
+
+            vector<string> const& cell_ids() const     { return ids;         }
+            vector<string> const& fields() const       { return field_names; }
+            uint64_t num_days() const                  { return days;        }
+
+            /**
+             * @brief Moves to a day, the next call to next() reads it
+             *
+             * @param index Index of the day in the log, from 0
+            */
+            void seek(uint64_t index)
+            {
+                in.clear();
+                in.seekg(data_start + index * block_size);
+            }
+
+            /**
+             * @brief Reads the next day
+             *
+             * @param d Day read, its columns are reused
+             * @return bool Whether there was a whole day left
+            */
+            bool next(day& d)
+            {
+                block.resize(block_size);
+                if (!in.read(block.data(), block.size()))
+                    return false;
+
+                char const* position = block.data();
+                memcpy(&d.time, position, sizeof(double));
+                position += sizeof(double);
+
+                unsigned int const num_cells = ids.size();
+                d.columns.resize(field_types.size());
+                for (unsigned int f = 0; f < field_types.size(); ++f)
+                {
+                    d.columns[f].resize(num_cells);
+                    for (unsigned int i = 0; i < num_cells; ++i)
+                    {
+                        if (field_types[f] == FLOAT64)
+                            memcpy(&d.columns[f][i], position, sizeof(double));
+                        else
+                        {
+                            float value;
+                            memcpy(&value, position, sizeof(float));
+                            d.columns[f][i] = value;
+                        }
+                        position += field_types[f];
+                    }
+                }
+
+                return true;
+            }
+    };
+
+    /**
+     * @brief Writes a binary state log as a text state log with every cell every day
+     *
+     * @param log Read from its current day to the end
+     * @param out Text log
+     * @return uint64_t Number of days written
+    */
+    uint64_t write_text(reader& log, ostream& out)
+    {
+        vector<string> const& ids = log.cell_ids();
+        if (log.fields().size() != sevirds::NUM_LOG_VALUES)
+            throw runtime_error{"The log doesn't hold the fields of a state"};
+        array<double, sevirds::NUM_LOG_VALUES> values{};
+
+        uint64_t days = 0;
+        day d;
+        while (log.next(d))
+        {
+            // Times are logged as the simulation's TIME, which is a float
+            out << (float)d.time << '\n';
+
+            // Cadmium names a cell after its coupled model, which is empty (see main.cpp)
+            for (unsigned int i = 0; i < ids.size(); ++i)
+            {
+                for (unsigned int f = 0; f < values.size(); ++f)
+                    values[f] = d.value(f, i);
+
+                out << "State for model _" << ids[i] << " is ";
+                log_format::write(out, values);
+                out << '\n';
+            }
+            ++days;
+        }
+
+        return days;
+    }
+} //namespace binary_state_log
+
+#endif //PANDEMIC_HOYA_2002_BINARY_STATE_LOG_HPP
@@ -3,8 +3,10 @@
 #ifndef AGE_DATA_HPP
 #define AGE_DATA_HPP
 
+#include <array>
 #include <vector>
 #include "sevirds.hpp"
+#include "../Helpers/Assert.hpp"
 
 using namespace std;
 using vecDouble = vector<double>;
@@ -12,6 +14,57 @@ using vecVecDouble = vector<vecDouble>;
 
 // Used as a null object for vectors that aren't needed
 static vecDouble EMPTY_VEC;
+static const_phase_view EMPTY_VIEW;
+
+/**
+ * Scratch memory for the AgeData objects of one thread. The working vectors of
+ * every population type are handed out from a single buffer that only grows when
+ * a cell with longer phases than any before it is computed, so once each cell
+ * shape has been seen computing a day doesn't allocate anything.
+*/
+class AgeDataWorkspace
+{
+    private:
+        vecDouble m_buffer;
+        unsigned int m_used = 0;
+
+    public:
+        /**
+         * @brief Workspace of the calling thread, big enough for size doubles
+         *
+         * @param size Scratch size of the cell about to be computed (see AgeData::ScratchSize())
+         * @return AgeDataWorkspace&
+        */
+        static AgeDataWorkspace& Local(unsigned int size)
+        {
+            thread_local AgeDataWorkspace workspace;
+            if (workspace.m_buffer.size() < size)
+                workspace.m_buffer.resize(size);
+            return workspace;
+        }
+
+        // Gives back every vector handed out so far. Done before each age group
+        void Release() { m_used = 0; }
+
+        /**
+         * @brief Hands out a vector of zeros
+         *
+         * @param size Number of doubles
+         * @return phase_view
+        */
+        phase_view Take(unsigned int size)
+        {
+            // Growing here would move the vectors already handed out.
+            // Only assert on failure as building the message allocates
+            if (m_used + size > m_buffer.size())
+                Assert::AssertLong(false, __FILE__, __LINE__, "AgeData workspace is too small for this cell");
+
+            phase_view view(m_buffer.data() + m_used, size);
+            m_used += size;
+            fill(view.data(), view.data() + size, 0.0);
+            return view;
+        }
+};
 
 /**
  * Wrapper class that holds important simulation data
@@ -31,18 +84,20 @@ class AgeData
     private:
         // Proportion Vectors for timestep t+1
         // These will be at a current age segment index so only one vector of doubles
-        vecDouble& m_susceptible;
-        vecDouble& m_exposed;
-        vecDouble& m_infected;
-        vecDouble& m_recovered;
+        // They view into the contiguous buffer of the sevirds object being computed
+        phase_view m_susceptible;
+        phase_view m_exposed;
+        phase_view m_infected;
+        phase_view m_recovered;
 
         // Reduces the amount of math that is done twice.
         // The values will be added in these when first done
         // then accessed later by other equations
-        vecDouble m_newFatalities;
-        vecDouble m_newRecoveries;
-        vecDouble m_newVacFromRec;
-        vecDouble m_newExposed;
+        // They view into the AgeDataWorkspace of the thread
+        phase_view m_newFatalities;
+        phase_view m_newRecoveries;
+        phase_view m_newVacFromRec;
+        phase_view m_newExposed;
 
         // Keeps track of the totals for the current
         // day in the simulation which saves time having
@@ -55,24 +110,22 @@ class AgeData
         double m_totalRecoveries;
 
         // Proportion Vectors for timestep t
-        /* Since the original vectors are being changed by the equations 
-        *   and later equations will need their values BEFORE they are 
-        *   changed let's copy them before they are change in seperate vectors.
-        *   This way we don't overcount and we don't have to do the math twice in
-        *   certain cases (ex: any equation that needs F(q) can just reference this
-        *   list instead of calculating it again).
+        /* The equations change the vectors of timestep t+1 while later equations
+        *   still need the values from BEFORE they were changed. Those are read from
+        *   the state of the current day, which is a separate buffer left untouched
+        *   while the next day is computed, so nothing has to be copied.
         */
-        vecDouble m_OriginalSusceptible;
-        vecDouble m_OriginalExposed;
-        vecDouble m_OriginalInfected;
-        vecDouble m_OriginalRecovered;
+        const_phase_view m_OriginalSusceptible;
+        const_phase_view m_OriginalExposed;
+        const_phase_view m_OriginalInfected;
+        const_phase_view m_OriginalRecovered;
 
         // Config Vectors
-        vecDouble const& m_incubRates;
-        vecDouble const& m_recovRates;
-        vecDouble const& m_fatalRates;
-        vecDouble const& m_vacRates;
-        vecDouble const& m_immuneRates;
+        const_phase_view m_incubRates;
+        const_phase_view m_recovRates;
+        const_phase_view m_fatalRates;
+        const_phase_view m_vacRates;
+        const_phase_view m_immuneRates;
 
         // Phase Lengths
         unsigned int m_susceptiblePhase;
@@ -81,32 +134,58 @@ class AgeData
         unsigned int m_recoveredPhase;
 
         PopType m_popType;
+
+        // Compartments of each population type (susceptible, exposed, infected, recovered)
+        static constexpr sevirds::compartment COMPARTMENTS[3][4] = {
+            { sevirds::SUSCEPTIBLE,   sevirds::EXPOSED,    sevirds::INFECTED,    sevirds::RECOVERED    }, // NVAC
+            { sevirds::VACCINATED_D1, sevirds::EXPOSED_D1, sevirds::INFECTED_D1, sevirds::RECOVERED_D1 }, // DOSE1
+            { sevirds::VACCINATED_D2, sevirds::EXPOSED_D2, sevirds::INFECTED_D2, sevirds::RECOVERED_D2 }  // DOSE2
+        };
+
+        static const_phase_view ImmunityRates(sevirds const& current, unsigned int age, PopType type)
+        {
+            if (type == PopType::DOSE1)
+                return current.immunityD1_rate(age);
+            if (type == PopType::DOSE2)
+                return current.immunityD2_rate(age);
+            return EMPTY_VIEW;
+        }
+
     public:
-        AgeData(unsigned int age, vecVecDouble& susc, vecVecDouble& exp, vecVecDouble& inf,
-                vecVecDouble& rec, vecVecDouble const& incub_r, vecVecDouble const& rec_r,
-                vecVecDouble const& fat_r, vecDouble const& vac_r, vecDouble const& immu_r, PopType type=PopType::NVAC) :
-            m_susceptible(susc.at(age)),
-            m_exposed(exp.at(age)),
-            m_infected(inf.at(age)),
-            m_recovered(rec.at(age)),
-            m_newFatalities(inf.at(age).size(), 0.0),
-            m_newRecoveries(inf.at(age).size(), 0.0),
-            m_newVacFromRec(rec.at(age).size(), 0.0),
-            m_newExposed(susc.at(age).size(), 0.0),
+        // Placeholder until the population type is set up for an age group
+        AgeData() : m_popType(PopType::NVAC) { }
+
+        /**
+         * @param workspace Scratch memory of the thread
+         * @param current State of the current day, read only
+         * @param res State of the next day which starts as a copy of current, written to
+         * @param age Age group index
+         * @param type Population type
+        */
+        AgeData(AgeDataWorkspace& workspace, sevirds const& current, sevirds& res, unsigned int age, PopType type,
+                vecVecDouble const& incub_r, vecVecDouble const& rec_r, vecVecDouble const& fat_r, vecDouble const& vac_r=EMPTY_VEC) :
+            m_susceptible(res.get(COMPARTMENTS[type][0], age)),
+            m_exposed(res.get(COMPARTMENTS[type][1], age)),
+            m_infected(res.get(COMPARTMENTS[type][2], age)),
+            m_recovered(res.get(COMPARTMENTS[type][3], age)),
+            m_newFatalities(workspace.Take(m_infected.size())),
+            m_newRecoveries(workspace.Take(m_infected.size())),
+            m_newVacFromRec(workspace.Take(m_recovered.size())),
+            m_newExposed(workspace.Take(m_susceptible.size())),
             m_totalSusceptible(0.0),
             m_totalExposed(0.0),
             m_totalInfected(0.0),
             m_totalFatalities(0.0),
             m_totalRecoveries(0.0),
-            m_OriginalSusceptible(susc.at(age)),
-            m_OriginalExposed(exp.at(age)),
-            m_OriginalInfected(inf.at(age)),
-            m_OriginalRecovered(rec.at(age)),
+            m_OriginalSusceptible(current.get(COMPARTMENTS[type][0], age)),
+            m_OriginalExposed(current.get(COMPARTMENTS[type][1], age)),
+            m_OriginalInfected(current.get(COMPARTMENTS[type][2], age)),
+            m_OriginalRecovered(current.get(COMPARTMENTS[type][3], age)),
             m_incubRates(incub_r.at(age)),
             m_recovRates(rec_r.at(age)),
             m_fatalRates(fat_r.at(age)),
-            m_vacRates(vac_r),     // Don't .at() this one since it may be EMPTY_VEC
-            m_immuneRates(immu_r), // This one too may be EMPTY_VEC
+            m_vacRates(vac_r), // Don't .at() this one since it may be EMPTY_VEC
+            m_immuneRates(ImmunityRates(current, age, type)),
             m_popType(type)
         {
             // -1 so for loops are easier
@@ -114,23 +193,23 @@ class AgeData
             m_exposedPhase     = m_exposed.size()     - 1;
             m_infectedPhase    = m_infected.size()    - 1;
             m_recoveredPhase   = m_recovered.size()   - 1;
-
-            m_OriginalExposed.reserve(m_exposedPhase + 1);
-            m_OriginalInfected.reserve(m_infectedPhase + 1);
-            m_OriginalRecovered.reserve(m_recoveredPhase + 1);
-            m_newFatalities.reserve(m_infectedPhase + 1);
         }
 
-        // Non-Vaccinated
-        //  No vaccination or immunity rates
-        AgeData(unsigned int age, vecVecDouble& susc, vecVecDouble& exp, vecVecDouble& inf,
-            vecVecDouble& rec, vecVecDouble const& incub_r, vecVecDouble const& rec_r, vecVecDouble const& fat_r) :
-            AgeData(age, susc, exp, inf, rec, incub_r, rec_r, fat_r, EMPTY_VEC, EMPTY_VEC)
-        { }
+        /**
+         * @brief Number of doubles an AgeData of this shape takes from the workspace
+         *
+         * @param susc Susceptible phase
+         * @param inf Infected phase
+         * @param rec Recovered phase
+         * @return unsigned int
+        */
+        static unsigned int ScratchSize(const_phase_view susc, const_phase_view inf, const_phase_view rec)
+        {
+            // New fatalities, recoveries, vaccinated from recovered and exposed
+            return susc.size() + 2 * inf.size() + rec.size();
+        }
 
         // GETTERS
-        double GetSusceptibleBack()     { return m_susceptible.back();         }
-        double GetRecoveredBack()       { return m_recovered.back();           }
         double GetNewFatalitiesBack()   { return m_newFatalities.back();       }
         double GetNewRecoveredBack()    { return m_newRecoveries.back();       }
         double GetOrigSusceptibleBack() { return m_OriginalSusceptible.back(); }
@@ -232,4 +311,25 @@ class AgeData
         }
 };
 
+/**
+ * The AgeData objects of every population type of an age group (i.e., NVac, Dose1, Dose2).
+ * They're kept inline so setting up an age group doesn't allocate
+*/
+class AgeDataSet
+{
+    private:
+        array<AgeData, 3> m_datas;
+        unsigned int m_size;
+
+    public:
+        explicit AgeDataSet(unsigned int size) : m_size(size) { }
+
+        AgeData& at(unsigned int index) { return m_datas.at(index); }
+
+        AgeData* begin() { return m_datas.data();          }
+        AgeData* end()   { return m_datas.data() + m_size; }
+
+        unsigned int size() const { return m_size; }
+};
+
 #endif // AGE_DATA_HPP
\ No newline at end of file
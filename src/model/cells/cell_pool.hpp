@@ -0,0 +1,189 @@
+#ifndef PANDEMIC_HOYA_2002_CELL_POOL_HPP
+#define PANDEMIC_HOYA_2002_CELL_POOL_HPP
+
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+using namespace std;
+
+/**
+ * Threads that do the same thing to every cell of a list. Each thread starts with its own
+ * range of cells and steals from the others once it runs out, since the number of
+ * neighbors (and so the work) varies a lot between cells. Used by lockstep_runner.hpp
+ * and parallel_transitions.hpp.
+*/
+template <typename CELL>
+class cell_pool
+{
+    public:
+        using task = function<void(CELL&)>;
+
+    private:
+        // Cells handed out at a time, small enough to balance and big enough to keep the locks cold
+        static constexpr unsigned int CHUNK = 8;
+
+        // Chunks of cells still to do by each thread. A thread takes from the front of its
+        // own range and steals from the back of the others
+        struct chunk_range
+        {
+            mutex lock;
+            unsigned int begin = 0;
+            unsigned int end   = 0;
+        };
+        vector<unique_ptr<chunk_range>> ranges; // One per thread, the calling thread is 0
+
+        vector<thread> workers;
+        mutex phase_lock;
+        condition_variable phase_start, phase_done;
+        vector<CELL*> const* cells = nullptr;
+        task const* body      = nullptr;
+        unsigned long phase   = 0;     // Bumped each time the workers are given a task
+        unsigned int pending  = 0;     // Workers still on the current task
+        bool stopping         = false;
+        exception_ptr failure = nullptr;
+
+        bool take(unsigned int thread_id, unsigned int& chunk)
+        {
+            chunk_range& own = *ranges[thread_id];
+            lock_guard<mutex> lock(own.lock);
+            if (own.begin == own.end)
+                return false;
+
+            chunk = own.begin++;
+            return true;
+        }
+
+        bool steal(unsigned int thread_id, unsigned int& chunk)
+        {
+            for (unsigned int i = 1; i < ranges.size(); ++i)
+            {
+                chunk_range& other = *ranges[(thread_id + i) % ranges.size()];
+                lock_guard<mutex> lock(other.lock);
+                if (other.begin != other.end)
+                {
+                    chunk = --other.end;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Runs the task on chunks until there are none left anywhere
+        void work(unsigned int thread_id, vector<CELL*> const& todo, task const& todo_body)
+        {
+            try
+            {
+                unsigned int chunk;
+                while (take(thread_id, chunk) || steal(thread_id, chunk))
+                {
+                    unsigned int last = min<size_t>((chunk + 1) * CHUNK, todo.size());
+                    for (unsigned int i = chunk * CHUNK; i < last; ++i)
+                        todo_body(*todo[i]);
+                }
+            }
+            catch (...)
+            {
+                lock_guard<mutex> lock(phase_lock);
+                if (!failure)
+                    failure = current_exception();
+            }
+        }
+
+        void worker(unsigned int thread_id)
+        {
+            unsigned long seen = 0;
+            while (true)
+            {
+                vector<CELL*> const* todo;
+                task const* todo_body;
+                {
+                    unique_lock<mutex> lock(phase_lock);
+                    phase_start.wait(lock, [&]() { return stopping || phase != seen; });
+                    if (stopping)
+                        return;
+                    seen      = phase;
+                    todo      = cells;
+                    todo_body = body;
+                }
+
+                work(thread_id, *todo, *todo_body);
+
+                lock_guard<mutex> lock(phase_lock);
+                if (--pending == 0)
+                    phase_done.notify_one();
+            }
+        }
+
+    public:
+        /**
+         * @param threads Number of threads doing the work, including the calling one
+        */
+        explicit cell_pool(unsigned int threads)
+        {
+            threads = max(1u, threads);
+            for (unsigned int t = 0; t < threads; ++t)
+                ranges.emplace_back(new chunk_range());
+            for (unsigned int t = 1; t < threads; ++t)
+                workers.emplace_back(&cell_pool::worker, this, t);
+        }
+
+        cell_pool(cell_pool const&) = delete;
+        cell_pool& operator=(cell_pool const&) = delete;
+
+        ~cell_pool()
+        {
+            {
+                lock_guard<mutex> lock(phase_lock);
+                stopping = true;
+            }
+            phase_start.notify_all();
+            for (thread& worker : workers)
+                worker.join();
+        }
+
+        /**
+         * @brief Runs body on every cell using all the threads, returns once they're all done.
+         * An exception thrown by body on any thread is thrown again from here
+         *
+         * @param todo Cells to run body on
+         * @param todo_body Done to each cell, from any thread
+         * @param meanwhile Done by the calling thread before it helps with the cells
+        */
+        void for_each_cell(vector<CELL*> const& todo, task const& todo_body, function<void()> const& meanwhile = nullptr)
+        {
+            unsigned int chunks = (todo.size() + CHUNK - 1) / CHUNK;
+            for (unsigned int t = 0; t < ranges.size(); ++t)
+            {
+                lock_guard<mutex> lock(ranges[t]->lock);
+                ranges[t]->begin = chunks * t / ranges.size();
+                ranges[t]->end   = chunks * (t + 1) / ranges.size();
+            }
+
+            {
+                lock_guard<mutex> lock(phase_lock);
+                cells   = &todo;
+                body    = &todo_body;
+                pending = workers.size();
+                failure = nullptr;
+                ++phase;
+            }
+            phase_start.notify_all();
+
+            if (meanwhile)
+                meanwhile();
+            work(0, todo, todo_body);
+
+            unique_lock<mutex> lock(phase_lock);
+            phase_done.wait(lock, [&]() { return pending == 0; });
+            if (failure)
+                rethrow_exception(failure);
+        }
+};
+
+#endif //PANDEMIC_HOYA_2002_CELL_POOL_HPP
@@ -0,0 +1,65 @@
+#ifndef PANDEMIC_HOYA_2002_CORRECTION_TABLE_HPP
+#define PANDEMIC_HOYA_2002_CORRECTION_TABLE_HPP
+
+#include <map>
+#include <array>
+#include <vector>
+
+using namespace std;
+
+/**
+ * The infection correction factors of a vicinity flattened into sorted arrays, along with the
+ * bounds of the hysteresis that starts when each threshold is crossed. Built once per distinct
+ * set of factors by neighborhood_graph::build() and shared by every edge that uses it.
+*/
+struct correction_table
+{
+    vector<float> thresholds;    // Ascending infection thresholds
+    vector<float> factors;       // Mobility correction factor of each threshold
+    vector<float> lower_bounds;  // Threshold minus its hysteresis
+    vector<float> higher_bounds; // Next threshold, or the same one for the last
+
+    correction_table() = default;
+
+    /**
+     * @param correction_factors Factors of a vicinity: threshold -> {mobility correction factor, hysteresis}
+    */
+    explicit correction_table(map<float, array<float, 2>> const& correction_factors)
+    {
+        for (auto const& pair : correction_factors)
+        {
+            thresholds.push_back(pair.first);
+            factors.push_back(pair.second.front());
+            lower_bounds.push_back(pair.first - pair.second.back());
+        }
+
+        for (unsigned int i = 0; i < thresholds.size(); ++i)
+            higher_bounds.push_back(thresholds[i + 1 < thresholds.size() ? i + 1 : i]);
+    }
+
+    /**
+     * @brief Finds the highest threshold the infections are at or above
+     *
+     * @param infections Total infections of a cell
+     * @return int Index of the threshold, -1 if none has been crossed
+    */
+    int crossed(double infections) const
+    {
+        unsigned int size = thresholds.size();
+        if (size == 0)
+            return -1;
+
+        // Halves the range without branching on the comparison
+        unsigned int base = 0;
+        while (size > 1)
+        {
+            unsigned int half = size / 2;
+            base = (thresholds[base + half] <= infections) ? base + half : base;
+            size -= half;
+        }
+
+        return (thresholds[base] <= infections) ? (int)base : -1;
+    }
+};
+
+#endif //PANDEMIC_HOYA_2002_CORRECTION_TABLE_HPP
@@ -11,9 +11,13 @@
 #include <cadmium/celldevs/cell/cell.hpp>
 #include <iomanip>
 #include "vicinity.hpp"
+#include "hysteresis_factor.hpp"
+#include "neighborhood_graph.hpp"
 #include "sevirds.hpp"
 #include "simulation_config.hpp"
+#include "rate_tables.hpp"
 #include "AgeData.hpp"
+#include "parallel_transitions.hpp"
 #include "../Helpers/Assert.hpp"
 
 using namespace std;
@@ -28,101 +32,200 @@ unsigned int const VAC2 = 2;
 unsigned int const BOOS = 3;
 
 template <typename T>
-class geographical_cell : public cell<T, string, sevirds, vicinity>
+class geographical_cell : public cell<T, string, sevirds_message, vicinity>
 {
     public:
         template <typename X>
         using cell_unordered = unordered_map<string, X>;
 
-        using cell<T, string, sevirds, vicinity>::simulation_clock;
-        using cell<T, string, sevirds, vicinity>::state;
-        using cell<T, string, sevirds, vicinity>::neighbors;
-        using cell<T, string, sevirds, vicinity>::cell_id;
+        using cell<T, string, sevirds_message, vicinity>::simulation_clock;
+        using cell<T, string, sevirds_message, vicinity>::state;
+        using cell<T, string, sevirds_message, vicinity>::neighbors;
+        using cell<T, string, sevirds_message, vicinity>::cell_id;
 
         using config_type = simulation_config;
 
-        using phase_rates = vector<     // The age sub_division
-                            vecDouble>; // The stage of infection
-
-        phase_rates virulence_rates;
-        phase_rates incubationD1_rates;
-        phase_rates incubationD2_rates;
-        phase_rates incubation_rates;
-        phase_rates recovery_rates;
-        phase_rates recoveryD1_rates;
-        phase_rates recoveryD2_rates;
-        phase_rates mobility_rates;
-        phase_rates fatality_rates;
-        phase_rates fatalityD1_rates;
-        phase_rates fatalityD2_rates;
-        phase_rates vac1_rates;
-        phase_rates vac2_rates;
-
-        // To make the parameters of the correction_factors variable more obvious
-        using infection_threshold        = float;
-        using mobility_correction_factor = array<float, 2>;  // array<mobility correction factor, hysteresis factor>;
+        // Shared with every other cell using the same rates (see rate_tables_registry)
+        shared_ptr<rate_tables const> rates;
 
         bool reSusceptibility, is_vaccination;
 
         unsigned int age_segments;
 
-        geographical_cell() : cell<T, string, sevirds, vicinity>() {}
+        // Doubles the AgeData objects of one age group take from the workspace
+        unsigned int scratch_size;
+
+        // Adjacency of the whole scenario, this cell's neighbors are the edges of its row
+        shared_ptr<neighborhood_graph const> graph;
+        unsigned int cell_index;
+
+        // Computes the cells ahead of Cadmium when it's set, see parallel_transitions.hpp
+        shared_ptr<parallel_transitions<T>> transitions;
+
+        geographical_cell() : cell<T, string, sevirds_message, vicinity>() {}
 
         geographical_cell(string const& cell_id, cell_unordered<vicinity> const& neighborhood,
-                            sevirds const& initial_state, string const& delay_id, simulation_config config) :
-            cell<T, string, sevirds, vicinity>(cell_id, neighborhood, initial_state, delay_id)
+                            sevirds const& initial_state, string const& delay_id, simulation_config const& config,
+                            shared_ptr<rate_tables const> rates, shared_ptr<neighborhood_graph const> graph,
+                            shared_ptr<parallel_transitions<T>> transitions = nullptr) :
+            cell<T, string, sevirds_message, vicinity>(cell_id, neighborhood, sevirds_message(initial_state), delay_id),
+            rates{move(rates)},
+            graph{move(graph)},
+            transitions{move(transitions)}
         {
-            for (const auto& i : neighborhood)
-                state.current_state.hysteresis_factors.insert({i.first, hysteresis_factor{}});
+            shared_ptr<sevirds> initial = make_shared<sevirds>(initial_state);
+
+            // One hysteresis factor per edge, in the same order as the edges of the cell's row
+            cell_index = this->graph->ids.at(cell_id);
+            hysteresis.fill(vector<hysteresis_factor>(neighborhood.size(), hysteresis_factor{}));
 
             // Set whether or not vaccines are being modeled
             // to be used in the getters found in sevirds.hpp
             // and later in this file
-            is_vaccination               = config.is_vaccination;
-            state.current_state.vaccines = is_vaccination;
+            is_vaccination    = config.is_vaccination;
+            initial->vaccines = is_vaccination;
 
             // Set the precision divider in the sevirds object
-            state.current_state.prec_divider          = (double)config.prec_divider;
-            state.current_state.one_over_prec_divider = 1.0 / (double)config.prec_divider;
+            initial->prec_divider          = (double)config.prec_divider;
+            initial->one_over_prec_divider = 1.0 / (double)config.prec_divider;
 
-            virulence_rates  = move(config.virulence_rates);
-            incubation_rates = move(config.incubation_rates);
-            recovery_rates   = move(config.recovery_rates);
-            mobility_rates   = move(config.mobility_rates);
-            fatality_rates   = move(config.fatality_rates);
+            publish(*initial, *this->rates);
 
             // Multiplication is always faster then division so set this up to be 1/prec_divider to be multiplied later
             reSusceptibility  = config.reSusceptibility;
             age_segments = initial_state.get_num_age_segments();
 
+            // Every age group has the same phase lengths so the first one sizes the workspace
+            sevirds const& shape = *initial;
+            scratch_size = AgeData::ScratchSize(shape.susceptible(0), shape.infected(0), shape.recovered(0));
             if (is_vaccination)
             {
-                vac1_rates = move(config.vac1_rates);
-                vac2_rates = move(config.vac2_rates);
+                scratch_size += AgeData::ScratchSize(shape.vaccinatedD1(0), shape.infectedD1(0), shape.recoveredD1(0))
+                              + AgeData::ScratchSize(shape.vaccinatedD2(0), shape.infectedD2(0), shape.recoveredD2(0))
+                              + shape.vaccinatedD1(0).size(); // Early dose 2 in compute_vaccinated()
+            }
+
+            // A second state of the full size now so the first step doesn't have to allocate one
+            states.push_back(initial);
+            states.push_back(make_shared<sevirds>(*initial));
+
+            current             = initial;
+            state.current_state = sevirds_message(initial);
+
+            if (this->transitions)
+                this->transitions->enlist(*this);
+        }
+
+        ~geographical_cell()
+        {
+            if (transitions)
+                transitions->leave(*this);
+        }
 
-                incubationD1_rates = move(config.incubationD1_rates);
-                incubationD2_rates = move(config.incubationD2_rates);
+        /**
+         * @brief This is the 'main' function for the class. The new state is computed into one
+         * of the cell's own states and Cadmium gets a message that shares it.
+         * With parallel transitions it may already be computed
+         * 
+         * @return sevirds_message
+        */
+        sevirds_message local_computation() const override
+        {
+            // Only step() moves current on, it would otherwise hold the first state forever
+            current.reset();
 
-                recoveryD1_rates = move(config.recovery_ratesD1);
-                recoveryD2_rates = move(config.recovery_ratesD2);
+            vector<sevirds_public const*> const& nstates = get_neighbor_states();
+            if (!transitions || !transitions->take(*this, nstates))
+                compute_next_state(*state.current_state.full, nstates, spare());
 
-                fatalityD1_rates = move(config.fatality_ratesD1);
-                fatalityD2_rates = move(config.fatality_ratesD2);
+            // Cadmium only replaces the state when it changed, the hysteresis goes with it
+            sevirds_message res(move(next));
+            if (res != state.current_state)
+            {
+                hysteresis_slot ^= 1;
+                if (transitions)
+                    transitions->sends(*this);
             }
+            return res;
+        }
+
+        /**
+         * @brief Computes the next state ahead of local_computation() from the current states
+         * of the neighbors (see parallel_transitions.hpp)
+         * 
+         * @param nstates States of the neighbors in the order of the cell's row in the graph
+        */
+        void compute_ahead(vector<sevirds_public const*> const& nstates) const
+        {
+            compute_next_state(*state.current_state.full, nstates, spare());
         }
 
         /**
-         * @brief This is the 'main' function for the class
-         * and is where all the equations for the the current cell
+         * @brief Step for when the cell is driven outside of Cadmium.
+         * The next day is computed into a spare state which then becomes the current one,
+         * so stepping never copies or allocates a whole state.
+         * 
+         * @param time Simulation time of the step
+         * @param nstates States of the neighbors in the order of the cell's row in the graph
+         * @return sevirds const& The new current state
+        */
+        sevirds const& step(T time, vector<sevirds_public const*> const& nstates)
+        {
+            compute_step(time, nstates);
+            commit_step();
+            return *current;
+        }
+
+        /**
+         * @brief First half of step(), computes the next day into a spare state.
+         * The current state isn't touched so the neighbors can keep reading it until every
+         * cell has been computed (see lockstep_runner.hpp)
+         * 
+         * @param time Simulation time of the step
+         * @param nstates States of the neighbors in the order of the cell's row in the graph
+        */
+        void compute_step(T time, vector<sevirds_public const*> const& nstates)
+        {
+            simulation_clock = time;
+            compute_next_state(*current, nstates, spare());
+        }
+
+        /**
+         * @brief Second half of step(), makes the computed day the current one.
+         * Like Cadmium the state is only replaced when it changed
+         * 
+         * @return bool Whether the state changed
+        */
+        bool commit_step()
+        {
+            bool changed = *next != *current;
+            if (changed)
+            {
+                current = next;
+                hysteresis_slot ^= 1;
+
+                // Cadmium's view of the state would otherwise hold the first state forever
+                state.current_state = sevirds_message(current);
+            }
+            next.reset();
+            return changed;
+        }
+
+        // State of the cell when it's stepped with step()
+        sevirds const& buffered_state() const { return *current; }
+
+        /**
+         * @brief This is where all the equations for the the current cell
          * and on the current day are computed for each age group
          * 
-         * @return sevirds
+         * @param current State of the cell on the current day
+         * @param nstates States of the neighbors in the order of the cell's row in the graph
+         * @param res Where the state of the next day is written. Its buffers are reused
         */
-        sevirds local_computation() const override
+        void compute_next_state(sevirds const& current, vector<sevirds_public const*> const& nstates, sevirds& res) const
         {
-            // Can't be a reference since it would need to be
-            // const and then we wouldn't be allowed to change its values
-            sevirds res = state.current_state;
+            // The vectors already have the right size so this doesn't allocate
+            res = current;
 
             // Number of AgeData objects needed
             // One for non-vac, dose1, dose2, and any booster shot populations
@@ -130,86 +233,140 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
             if (is_vaccination)
                 size += 2;
 
-            // Initialize them in a vector for easy moving around the functions
-            vector<unique_ptr<AgeData>> datas;
-            for (int i = 0; i < size; ++i)
-                datas.push_back(unique_ptr<AgeData>(nullptr));
+            // Kept together for easy moving around the functions.
+            // Their vectors come from the workspace of this thread so nothing is allocated
+            AgeDataSet datas(size);
+            AgeDataWorkspace& workspace = AgeDataWorkspace::Local(scratch_size);
 
             // Global new susceptible variable as the other equations
             // remove their proportions from this one leaving it with
             // the remaning susceptible proportion
             double new_s;
 
+            // The neighborhood sum doesn't depend on the age group, phase day or population type
+            // so it is computed once here and then shared by every exposure equation
+            double foi = force_of_infection(res, nstates);
+
             // Calculate the next new sevirds variables for each age group
             for (unsigned int age_segment_index = 0; age_segment_index < age_segments; ++age_segment_index)
             {
                 // Reset for susceptible equation
                 new_s = 1;
 
+                // The previous age group is done with its vectors
+                workspace.Release();
+
                 // Init the non-vac object for the current age group
-                datas.at(NVAC).reset(new AgeData(age_segment_index, res.susceptible, res.exposed, res.infected,
-                                                res.recovered, incubation_rates, recovery_rates, fatality_rates));
+                datas.at(NVAC) = AgeData(workspace, current, res, age_segment_index, AgeData::PopType::NVAC,
+                                         rates->incubation_rates, rates->recovery_rates, rates->fatality_rates);
 
                 if (is_vaccination)
                 {
                     // Init the vac object for the current age group
-                    datas.at(VAC1).reset(new AgeData(age_segment_index, res.vaccinatedD1, res.exposedD1, res.infectedD1,
-                                                    res.recoveredD1, incubationD1_rates, recoveryD1_rates,
-                                                    fatalityD1_rates, vac1_rates.at(age_segment_index),
-                                                    res.immunityD1_rate.at(age_segment_index), AgeData::PopType::DOSE1));
-                    datas.at(VAC2).reset(new AgeData(age_segment_index, res.vaccinatedD2, res.exposedD2, res.infectedD2,
-                                                    res.recoveredD2, incubationD2_rates, recoveryD2_rates,
-                                                    fatalityD2_rates, vac2_rates.at(age_segment_index),
-                                                    res.immunityD2_rate.at(age_segment_index), AgeData::PopType::DOSE2));
+                    datas.at(VAC1) = AgeData(workspace, current, res, age_segment_index, AgeData::PopType::DOSE1,
+                                             rates->incubationD1_rates, rates->recoveryD1_rates, rates->fatalityD1_rates,
+                                             rates->vac1_rates.at(age_segment_index));
+                    datas.at(VAC2) = AgeData(workspace, current, res, age_segment_index, AgeData::PopType::DOSE2,
+                                             rates->incubationD2_rates, rates->recoveryD2_rates, rates->fatalityD2_rates,
+                                             rates->vac2_rates.at(age_segment_index));
 
                     // Equations for Vaccinated population (eg. EV1, RV2...)
                     sanity_check(res.get_total_susceptible(true, age_segment_index), __LINE__);
-                    compute_vaccinated(datas, res);
+                    compute_vaccinated(datas, workspace, res, foi);
 
                     // S = 1 - V1 - V2
-                    new_s -= datas.at(VAC1).get()->GetTotalSusceptible(); // 1e
+                    new_s -= datas.at(VAC1).GetTotalSusceptible(); // 1e
                     sanity_check(new_s, __LINE__);
-                    new_s -= datas.at(VAC2).get()->GetTotalSusceptible(); // 2d
+                    new_s -= datas.at(VAC2).GetTotalSusceptible(); // 2d
                     sanity_check(new_s, __LINE__);
                 }
 
                 // Compute the Exposed, Infected, Recovered, and Fatalities equations
                 // for all population types
-                compute_EIRD(datas, res);
+                compute_EIRD(datas, res, foi);
 
                 // S = 1 - E - I - R - F
-                for (unique_ptr<AgeData>& data : datas)
+                for (AgeData& data : datas)
                 {
-                    new_s -= data.get()->GetTotalExposed();
+                    new_s -= data.GetTotalExposed();
                     sanity_check(new_s, __LINE__);
 
-                    new_s -= data.get()->GetTotalInfected();
+                    new_s -= data.GetTotalInfected();
                     sanity_check(new_s, __LINE__);
 
-                    new_s -= data.get()->GetTotalRecovered();
+                    new_s -= data.GetTotalRecovered();
                     sanity_check(new_s, __LINE__);
 
                     // Using the total is currently broken but is the ideal as it removes the need
                     // to loop every cycle
-                    //res.fatalities.at(age_segment_index) += data.get()->GetTotalFatalities();
+                    //res.fatalities.at(age_segment_index) += data.GetTotalFatalities();
                     // For some reason doing this loop gives the correct result when the Total does not
-                    for (unsigned int q = 0; q < data.get()->GetInfectedPhase(); ++q)
-                        res.fatalities.at(age_segment_index) += data.get()->GetNewFatalities(q);
-                    sanity_check(res.fatalities.at(age_segment_index), __LINE__);
+                    for (unsigned int q = 0; q < data.GetInfectedPhase(); ++q)
+                        res.fatalities(age_segment_index) += data.GetNewFatalities(q);
+                    sanity_check(res.fatalities(age_segment_index), __LINE__);
                 }
 
-                new_s -= res.fatalities.at(age_segment_index);
+                new_s -= res.fatalities(age_segment_index);
                 sanity_check(new_s, __LINE__);
 
-                res.susceptible.at(age_segment_index).front() = new_s;
+                res.susceptible(age_segment_index).front() = new_s;
             } //for(age_groups)
 
-            return res;
-        } //local_computation()
+            publish(res, *rates);
+        } //compute_next_state()
+
+        /**
+         * @brief Computes the values this cell shares with its neighbors and the totals of the
+         * state. Done once when a state is committed rather than by every neighbor or logger
+         * that reads the state
+         * 
+         * @param res State to be sent to the neighbors
+         * @param rates Rates of the cell, μ(n) and λ(n) for each age group are used
+        */
+        static void publish(sevirds& res, rate_tables const& rates)
+        {
+            double inner_sum = 0, inner_sumV1 = 0, inner_sumV2 = 0;
+
+            res.infectiousness = 0;
+
+            // bϵ{1...A}
+            for (unsigned int age_group = 0; age_group < res.num_age_groups; ++age_group)
+            {
+                // μ(n) * λ(n), premultiplied when the rates were loaded
+                const_phase_view weights = rates.transmission_weights(age_group);
+                if (res.get_num_infected_phases() > weights.size()
+                    || (res.vaccines && max(res.layout[sevirds::INFECTED_D1].phases, res.layout[sevirds::INFECTED_D2].phases) > weights.size()))
+                    AssertLong(false, __FILE__, __LINE__, "There must be a mobility and virulence rate for every day of the infected phases");
+
+                // The inner sums carry over from one age group to the next,
+                // this is how the neighborhood sum has always accumulated them
+                // nϵ{1...Ti}: μ(n) * λ(n) * I(n)
+                const_phase_view infected = res.infected(age_group);
+                inner_sum += transmission_kernels::dot(weights.data(), infected.data(), infected.size());
+
+                if (res.vaccines)
+                {
+                    // nϵ{1...Ti,V1}: μ(n) * λ(n) * IV1(n)
+                    const_phase_view infectedD1 = res.infectedD1(age_group);
+                    inner_sumV1 += transmission_kernels::dot(weights.data(), infectedD1.data(), infectedD1.size());
+
+                    // nϵ{1...Ti,V2}: μ(n) * λ(n) * IV2(n)
+                    const_phase_view infectedD2 = res.infectedD2(age_group);
+                    inner_sumV2 += transmission_kernels::dot(weights.data(), infectedD2.data(), infectedD2.size());
+                }
+
+                res.infectiousness += (inner_sum + inner_sumV1 + inner_sumV2)   // sum(1...Ti)
+                                      * res.age_group_proportion(age_group)     // Njb / Nj
+                    ;
+            }
+
+            res.summarize();
+            res.total_infections = res.totals.infections;
+        }
 
         // It returns the delay to communicate cell's new state.
         // It looks useless but it is extremely important. Do NOT delete!
-        T output_delay(sevirds const& cell_state) const override { return 1; }
+        T output_delay(sevirds_message const& cell_state) const override { return 1; }
 
         /**
          * @brief Vaccinated Dose 1 - Equation 1a
@@ -218,26 +375,26 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
          * @param res State machine object that holds simulation config data
          * @return double
          */
-        double new_vaccinated1(vector<unique_ptr<AgeData>>& datas, sevirds const& res) const
+        double new_vaccinated1(AgeDataSet& datas, sevirds const& res) const
         {
             // Vaccination rate with those who are susceptible
             // vd1 * S
-            double new_vac1 = datas.at(VAC1).get()->GetVaccinationRate(0)  // vd1
-                            * datas.at(NVAC).get()->GetOrigSusceptible(0); // * S
+            double new_vac1 = datas.at(VAC1).GetVaccinationRate(0)  // vd1
+                            * datas.at(NVAC).GetOrigSusceptible(0); // * S
 
             // And those who are in the recovery phase
             double sum = 0;
-            for (unsigned int q = datas.at(NVAC).get()->GetRecoveredPhase() - 1; q > res.min_interval_recovery_to_vaccine; --q)
+            for (unsigned int q = datas.at(NVAC).GetRecoveredPhase() - 1; q > res.min_interval_recovery_to_vaccine; --q)
             {
                 // Remember these values in the non-vac object as
                 // they are removed from the susceptible group
                 // in increment_recoveries(). Only do math once!!
-                datas.at(NVAC).get()->SetVacFromRec(q - 1,
-                                                    datas.at(NVAC).get()->GetOrigRecovered(q - 1) // R(q)
-                                                    * datas.at(VAC1).get()->GetVaccinationRate(0) // vd1
+                datas.at(NVAC).SetVacFromRec(q - 1,
+                                             datas.at(NVAC).GetOrigRecovered(q - 1) // R(q)
+                                             * datas.at(VAC1).GetVaccinationRate(0) // vd1
                 );
 
-                sum += datas.at(NVAC).get()->GetVacFromRec(q - 1);
+                sum += datas.at(NVAC).GetVacFromRec(q - 1);
             }
 
             return new_vac1 + sum;
@@ -248,12 +405,14 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
          * 
          * @param datas Vector containing the three population types with their respective data
          * @param res Current state of the cell
+         * @param earlyVac2 Those who received their second dose early from the dose 1 susceptible group
+         * @param foi Force of infection computed by force_of_infection()
          * @return double
          */
-        double new_vaccinated2(vector<unique_ptr<AgeData>>& datas, sevirds& res, vecDouble const& earlyVac2) const
+        double new_vaccinated2(AgeDataSet& datas, sevirds& res, const_phase_view earlyVac2, double foi) const
         {
-            AgeData& age_data_vac1 = *(datas.at(VAC1)).get();
-            AgeData& age_data_vac2 = *(datas.at(VAC2)).get();
+            AgeData& age_data_vac1 = datas.at(VAC1);
+            AgeData& age_data_vac2 = datas.at(VAC2);
 
             // Everybody on the last day of dose 1 is moved to dose 2
             double vac2 = age_data_vac1.GetOrigSusceptibleBack(); // V1(td1)
@@ -261,7 +420,7 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
             // Some people are eligible to receive their second dose sooner
             // and this was already computed ealier in compute_vaccinated()
             // qϵ{mtd1...td1 - 1}
-            vac2 += accumulate(earlyVac2.begin(), earlyVac2.end(), 0.0);
+            vac2 += sevirds::sum_state_vector(earlyVac2);
 
             // Some people are eligible to receive their second dose sooner from the dose 1 recovery pop
             // qϵ{mtd1...Tr}
@@ -278,99 +437,107 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
             }
 
             // - V1(td1) * sum(1...k and 1...Ti))
-            return vac2 - new_exposed(res, *(datas.at(VAC1).get()), age_data_vac1.GetSusceptiblePhase());
+            return vac2 - new_exposed(age_data_vac1, foi, age_data_vac1.GetSusceptiblePhase());
         }
 
         /**
-         * @brief Calculates proportion of new exposures from either non-vac or vac (dose 1 or 2) population.
-         * 1b, 1c, 1d, 1e, 1f, 2b, 2c, 2d, 2e, 3a, 3b and 3c use this
+         * @brief Computes the force of infection the neighborhood exerts on this cell
+         *  sum( jϵ{1...k}(cij * kij * sum(bϵ{1...A} and nϵ{1...Ti}[...])) )
+         *  It is the same for every age group, phase day and population type so
+         *  local_computation() only calls this once per step. The hysteresis of each edge
+         *  of the next day is computed here, once
          * 
-         * @param res State machine object that holds simulation config data
-         * @param age_data Reference to current simulation data
-         * @param q Index to compute equation
+         * @param res State of the cell at the next time step
+         * @param nstates States of the neighbors in the order of the cell's row in the graph
          * @return double
         */
-        double new_exposed(sevirds& res, AgeData& age_data, int q=0) const
+        double force_of_infection(sevirds const& res, vector<sevirds_public const*> const& nstates) const
         {
-            double expos = 0, sum = 0, inner_sum, inner_sumV1, inner_sumV2;
+            double sum = 0;
+
+            neighborhood_graph const& g  = *graph;
+            unsigned int const row_begin = g.row_begin(cell_index);
+            unsigned int const row_end   = g.row_end(cell_index);
+            unsigned int const self_edge = g.self_edges[cell_index];
+
+            // Starts from the hysteresis of the current day, the vectors already have the right size
+            vector<hysteresis_factor>& next_hysteresis = hysteresis[hysteresis_slot ^ 1];
+            next_hysteresis = hysteresis[hysteresis_slot];
 
             // Calculate the correction factor of the current cell.
             // The current cell must be part of its own neighborhood for this to work!
-            vicinity self_vicinity = state.neighbors_vicinity.at(cell_id);
             double current_cell_correction_factor = res.disobedient
                                                     + (1 - res.disobedient)
-                                                    * movement_correction_factor(self_vicinity.correction_factors,
-                                                                                state.neighbors_state.at(cell_id).get_total_infections(),
-                                                                                res.hysteresis_factors.at(cell_id));
+                                                    * movement_correction_factor(g.correction_tables[g.correction_ids[self_edge]],
+                                                                                nstates[self_edge - row_begin]->total_infections,
+                                                                                next_hysteresis[self_edge - row_begin]);
 
             double neighbor_correction;
 
             // jϵ{1...k}
-            for (string neighbor : neighbors)
+            for (unsigned int e = row_begin; e < row_end; ++e)
             {
-                sevirds const& nstate = state.neighbors_state.at(neighbor);       // Cell j's state
-                vicinity const& v     = state.neighbors_vicinity.at(neighbor);    // Holds cij and a correction factor used in kij
-
-                // Disobedient people have a correction factor of 1. The rest of the population is affected by the movement_correction_factor
-                neighbor_correction = nstate.disobedient
-                                        + (1 - nstate.disobedient)
-                                        * movement_correction_factor(v.correction_factors,
-                                                                    nstate.get_total_infections(),
-                                                                    res.hysteresis_factors.at(neighbor));
+                sevirds_public const& nstate = *nstates[e - row_begin]; // Cell j's state
+
+                // Disobedient people have a correction factor of 1. The rest of the population is affected by the movement_correction_factor.
+                // The cell's own edge was just computed
+                if (e == self_edge)
+                    neighbor_correction = current_cell_correction_factor;
+                else
+                    neighbor_correction = nstate.disobedient
+                                            + (1 - nstate.disobedient)
+                                            * movement_correction_factor(g.correction_tables[g.correction_ids[e]],
+                                                                        nstate.total_infections,
+                                                                        next_hysteresis[e - row_begin]);
 
                 // Logically makes sense to require neighboring cells to follow the movement restriction that is currently
                 // in place in the current cell if the current cell has a more restrictive movement.
                 neighbor_correction = min(current_cell_correction_factor, neighbor_correction);
 
-                // Reset the inner sum for the next neighbor
-                inner_sum = 0; inner_sumV1 = 0; inner_sumV2 = 0;
+                sum += g.correlations[e]       // cij
+                       * neighbor_correction   // kij
+                       * nstate.infectiousness // sum(bϵ{1...A} and nϵ{1...Ti}[...])
+                    ;
+            }
 
-                // bϵ{1...A}
-                for (unsigned int age_group = 0; age_group < nstate.num_age_groups; ++age_group)
-                {
+            return sum;
+        } //force_of_infection()
 
-                    // nϵ{1...Ti}
-                    for (unsigned int n = 0; n < nstate.infected.at(age_group).size(); ++n)
-                    {
-                        inner_sum +=
-                            mobility_rates.at(age_group).at(n)    // μ(n)
-                            * virulence_rates.at(age_group).at(n) // λ(n)
-                            * nstate.infected.at(age_group).at(n) // I(n)
-                            ;
-                    }
+        /**
+         * @brief The states received from the neighbors in the order of the cell's row in the graph.
+         * They're looked up by cell id only the first time; the entries of neighbors_state are
+         * updated in place by Cadmium so the addresses stay valid afterwards
+         * 
+         * @return vector<sevirds_public const*> const&
+        */
+        vector<sevirds_public const*> const& get_neighbor_states() const
+        {
+            if (neighbor_states_owner != &state.neighbors_state)
+            {
+                neighborhood_graph const& g = *graph;
 
-                    if (is_vaccination)
-                    {
-                        // nϵ{1...Ti,V1}
-                        for (unsigned int n = 0; n < nstate.infectedD1.at(age_group).size(); ++n)
-                        {
-                            inner_sumV1 +=
-                                mobility_rates.at(age_group).at(n)      // μ(n)
-                                * virulence_rates.at(age_group).at(n)   // λ(n)
-                                * nstate.infectedD1.at(age_group).at(n) // IV1(n)
-                                ;
-                        }
-
-                        // nϵ{1...Ti,V2}
-                        for (unsigned int n = 0; n < nstate.infectedD2.at(age_group).size(); ++n)
-                        {
-                            inner_sumV2 +=
-                                mobility_rates.at(age_group).at(n)      // μ(n)
-                                * virulence_rates.at(age_group).at(n)   // λ(n)
-                                * nstate.infectedD2.at(age_group).at(n) // IV2(n)
-                                ;
-                        }
-                    }
+                neighbor_states.clear();
+                for (unsigned int e = g.row_begin(cell_index); e < g.row_end(cell_index); ++e)
+                    neighbor_states.push_back(&state.neighbors_state.at(g.cell_ids[g.neighbors[e]]));
 
-                    sum += v.correlation                                // cij
-                           * neighbor_correction                        // kij
-                           * (inner_sum + inner_sumV1 + inner_sumV2)    // sum(1...Ti)
-                           * nstate.age_group_proportions.at(age_group) // Njb / Nj
-                        ;
-                }
+                neighbor_states_owner = &state.neighbors_state;
             }
 
-            expos = age_data.GetOrigSusceptible(q) * sum; // S * sum(1...k)
+            return neighbor_states;
+        }
+
+        /**
+         * @brief Calculates proportion of new exposures from either non-vac or vac (dose 1 or 2) population.
+         * 1b, 1c, 1d, 1e, 1f, 2b, 2c, 2d, 2e, 3a, 3b and 3c use this
+         * 
+         * @param age_data Reference to current simulation data
+         * @param foi Force of infection computed by force_of_infection()
+         * @param q Index to compute equation
+         * @return double
+        */
+        double new_exposed(AgeData& age_data, double foi, int q=0) const
+        {
+            double expos = age_data.GetOrigSusceptible(q) * foi; // S * sum(1...k)
 
             if (age_data.GetType() != AgeData::PopType::NVAC)
                 expos *= 1.0 - age_data.GetImmunityRate( int((q - 1) * 0.14f) ); // 1 - i(q)
@@ -416,7 +583,7 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
 
             /* Scan through all exposed days and calculate exposed.at(age).at(q)
             *   Incubation Rate on Te must be 1.0
-            *   Note: age_data.get()->GetOrigExposed(i) == exposed.at(age).at(q) 
+            *   Note: age_data.GetOrigExposed(i) == exposed.at(age).at(q) 
             *   and at timestep t not t+1
             *   qϵ{1...Te-1}
             */
@@ -513,7 +680,7 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
 
                 // When resusceptibility is off then those who are recovered stay in that phase
                 if (!reSusceptibility && q == age_data.GetRecoveredPhase())
-                    curr_rec += age_data.GetRecoveredBack();
+                    curr_rec += age_data.GetOrigRecoveredBack();
 
                 // Each day of the recovered phase is the value of the previous day. The population on the last day is
                 // now susceptible (assuming a re-susceptible model); this is implicitly done already as the susceptible value was set to 1.0 and the
@@ -544,6 +711,9 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
         {
             double new_f = 0.0, sum;
 
+            // The state isn't changed by this loop so the total only has to be summed once
+            bool hospitals_full = res.get_total_infections() > res.hospital_capacity;
+
             // Calculate all those who have died during an infection stage.
             // qϵ{1...Ti}
             for (unsigned int q = 0; q <= age_data.GetInfectedPhase(); ++q)
@@ -552,7 +722,7 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                 sum = age_data.GetFatalityRate(q) * age_data.GetOrigInfected(q);
 
                 // Amplify fatality rate if the hospitals are full
-                if (res.get_total_infections() > res.hospital_capacity)
+                if (hospitals_full)
                     sum *= res.fatality_modifier;
 
                 new_f += sum;
@@ -563,7 +733,7 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
             return new_f;
         }
 
-        double movement_correction_factor(const map<infection_threshold, mobility_correction_factor>& mobility_correction_factors,
+        double movement_correction_factor(correction_table const& mobility_correction_factors,
                                         double infectious_population, hysteresis_factor& hysteresisFactor) const
         {
             // For example, assume a correction factor of "0.4": [0.2, 0.1]. If the infection goes above 0.4, then the
@@ -579,53 +749,43 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
 
             hysteresisFactor.in_effect = false;
 
-            double correction = 1.0;
-            for (auto const& pair: mobility_correction_factors)
-            {
-                if (infectious_population >= pair.first)
-                {
-                    correction = pair.second.front();
-
-                    // A hysteresis factor will be in effect until the total infection goes below the hysteresis factor;
-                    // until that happens the information required to return a movement factor must be kept in above variables.
-
-                    // Get the threshold of the next correction factor; otherwise the current correction factor can remain in
-                    // effect if the total infections never goes below the lower bound hysteresis factor, but also if it goes
-                    // above the original total infection threshold!
-                    auto next_pair_iterator = find(mobility_correction_factors.begin(), mobility_correction_factors.end(), pair);
-                    AssertLong(next_pair_iterator != mobility_correction_factors.end(), __FILE__, __LINE__);
-
-                    // If there is a next correction factor (for a higher total infection), then use it's total infection threshold
-                    if ((long unsigned int) distance(mobility_correction_factors.begin(), next_pair_iterator) != mobility_correction_factors.size() - 1)
-                        ++next_pair_iterator;
-
-                    hysteresisFactor.in_effect                  = true;
-                    hysteresisFactor.infections_higher_bound    = next_pair_iterator->first;
-                    hysteresisFactor.infections_lower_bound     = pair.first - pair.second.back();
-                    hysteresisFactor.mobility_correction_factor = pair.second.front();
-                } else
-                    break;
-            }
+            // The highest threshold the infections have crossed decides the correction factor
+            int i = mobility_correction_factors.crossed(infectious_population);
+            if (i < 0)
+                return 1.0;
 
-            return correction;
+            // A hysteresis factor will be in effect until the total infection goes below the hysteresis factor;
+            // until that happens the information required to return a movement factor must be kept in above variables.
+
+            // The higher bound is the threshold of the next correction factor; otherwise the current correction factor can
+            // remain in effect if the total infections never goes below the lower bound hysteresis factor, but also if it goes
+            // above the original total infection threshold!
+            hysteresisFactor.in_effect                  = true;
+            hysteresisFactor.infections_higher_bound    = mobility_correction_factors.higher_bounds[i];
+            hysteresisFactor.infections_lower_bound     = mobility_correction_factors.lower_bounds[i];
+            hysteresisFactor.mobility_correction_factor = mobility_correction_factors.factors[i];
+
+            return mobility_correction_factors.factors[i];
         } //movement_correction_factor()
 
         /**
          * @brief Computes all the equations specific to the vaccinated population
          * 
          * @param datas Vector of AgeData objects containing current age group data
+         * @param workspace Scratch memory of the AgeData objects
          * @param res The current state of the geographical cell
+         * @param foi Force of infection computed by force_of_infection()
         */
-        void compute_vaccinated(vector<unique_ptr<AgeData>>& datas, sevirds& res) const
+        void compute_vaccinated(AgeDataSet& datas, AgeDataWorkspace& workspace, sevirds& res, double foi) const
         {
             double curr_vac1 = 0.0, curr_vac2 = 0.0;
 
-            AgeData& age_data_vac1 = *(datas.at(VAC1).get());
-            AgeData& age_data_vac2 = *(datas.at(VAC2).get());
+            AgeData& age_data_vac1 = datas.at(VAC1);
+            AgeData& age_data_vac2 = datas.at(VAC2);
 
             // Holds those who get their second dose earlier from the susceptible dose 1 group
             // This is not the same as vacFromRec in AgeData.hpp
-            vecDouble earlyVac2(age_data_vac1.GetSusceptiblePhase(), 0.0);
+            phase_view earlyVac2 = workspace.Take(age_data_vac1.GetSusceptiblePhase());
 
             // <VACCINATED DOSE 1>
                 // Calculate the number of new vaccinated dose 1
@@ -637,7 +797,7 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                     // 1b & 1d
                     curr_vac1 = age_data_vac1.GetOrigSusceptible(q - 1); // V1(q - 1)
 
-                    age_data_vac1.SetNewExposed(q, new_exposed(res, age_data_vac1, q - 1));
+                    age_data_vac1.SetNewExposed(q, new_exposed(age_data_vac1, foi, q - 1));
                     curr_vac1 -= age_data_vac1.GetNewExposed(q); // - ( V1(q - 1) * (1 - iv1(q - 1)) * sum(1..k and 1...Ti) )
 
                     // Early dose 2
@@ -645,16 +805,16 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                     {
                         // 1d
                         if (q > res.min_interval_recovery_to_vaccine)
-                            earlyVac2.at(q - 1) = age_data_vac2.GetVaccinationRate(q - 1 - res.min_interval_recovery_to_vaccine) // vd2(q - 1)
+                            earlyVac2[q - 1] = age_data_vac2.GetVaccinationRate(q - 1 - res.min_interval_recovery_to_vaccine) // vd2(q - 1)
                                                 * age_data_vac1.GetOrigSusceptible(q - 1)                                        // * V1(q - 1)
                             ;
                         // 1c substracts early dose2 vaccinations from 1b
                         else
-                            earlyVac2.at(q - 1) = age_data_vac2.GetVaccinationRate(q - 1 - res.min_interval_doses) // vd2(q - 1)
+                            earlyVac2[q - 1] = age_data_vac2.GetVaccinationRate(q - 1 - res.min_interval_doses) // vd2(q - 1)
                                                 * age_data_vac1.GetOrigSusceptible(q - 1)                          // * V1(q - 1)
                             ;
 
-                        curr_vac1 -= earlyVac2.at(q - 1);
+                        curr_vac1 -= earlyVac2[q - 1];
                     }
 
                     sanity_check(curr_vac1, __LINE__);
@@ -678,7 +838,7 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
 
             // <VACCINATED DOSE 2>
                 // Calculate the number of new vaccinated dose 2
-                double new_vac2 = new_vaccinated2(datas, res, earlyVac2);
+                double new_vac2 = new_vaccinated2(datas, res, earlyVac2, foi);
                 sanity_check(new_vac2, __LINE__);
 
                 // qϵ{2...td2 - 1}
@@ -687,7 +847,7 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                     // 2b
                     curr_vac2 = age_data_vac2.GetOrigSusceptible(q - 1); // V2(q - 1)
 
-                    age_data_vac2.SetNewExposed(q, new_exposed(res, age_data_vac2, q - 1));
+                    age_data_vac2.SetNewExposed(q, new_exposed(age_data_vac2, foi, q - 1));
                     curr_vac2 -= age_data_vac2.GetNewExposed(q); // - V2(q - 1) * (1 - iv2(q - 1)) * sum( jϵ{1…k}(cij * kij * sum(bϵ{1...A} and nϵ{1...Ti}[...])) )
 
                     sanity_check(curr_vac2, __LINE__);
@@ -698,8 +858,8 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                 double end = age_data_vac2.GetOrigSusceptible(age_data_vac2.GetSusceptiblePhase() - 1) // V2(td2 - 1)
                       + age_data_vac2.GetOrigSusceptibleBack();                                        // V2(td2)
 
-                age_data_vac2.SetNewExposed(age_data_vac2.GetSusceptiblePhase() - 1, new_exposed(res, age_data_vac2, age_data_vac2.GetSusceptiblePhase() - 1));
-                age_data_vac2.SetNewExposed(age_data_vac2.GetSusceptiblePhase(), new_exposed(res, age_data_vac2, age_data_vac2.GetSusceptiblePhase()));
+                age_data_vac2.SetNewExposed(age_data_vac2.GetSusceptiblePhase() - 1, new_exposed(age_data_vac2, foi, age_data_vac2.GetSusceptiblePhase() - 1));
+                age_data_vac2.SetNewExposed(age_data_vac2.GetSusceptiblePhase(), new_exposed(age_data_vac2, foi, age_data_vac2.GetSusceptiblePhase()));
                 end -= age_data_vac2.GetNewExposed(age_data_vac2.GetSusceptiblePhase() - 1); // - V2(td2 - 1) * (1 - iV2(td2 - 1)) * sum( jϵ{1...k}(cij * kij * sum(bϵ{1...A} and nϵ{1...Ti}[...]) )
                 end -= age_data_vac2.GetNewExposed(age_data_vac2.GetSusceptiblePhase());     // - V2(td2) * (1 - iV2(td2)) * sum( jϵ{1...k}(cij * kij * sum(bϵ{1...A} and nϵ{1...Ti}[...]) )
 
@@ -719,14 +879,14 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
          * 
          * @param datas Vector of pointers holding the population states (i.e., NVac, Dose1, Dose2)
          * @param res Current cell data
+         * @param foi Force of infection computed by force_of_infection()
          */
-        void compute_EIRD(vector<unique_ptr<AgeData>>& datas, sevirds& res) const
+        void compute_EIRD(AgeDataSet& datas, sevirds& res, double foi) const
         {
             double new_expos, new_inf, new_rec;
 
-            for (unique_ptr<AgeData>& age_data_ptr : datas)
+            for (AgeData& age_data : datas)
             {
-                AgeData& age_data = *(age_data_ptr.get());
                 // <FATALITIES>
                     // Calculates the new fatalities on each day of the infected phase
                     // for easy use and less repetive code later
@@ -748,7 +908,7 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                         if (age_data.GetType() != AgeData::PopType::NVAC)
                             new_expos += age_data.GetNewExposed(q);
                         else
-                            new_expos += new_exposed(res, age_data, q);
+                            new_expos += new_exposed(age_data, foi, q);
                     }
 
                     increment_exposed(age_data);
@@ -783,7 +943,8 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
          */
         void sanity_check(double value, unsigned int line) const
         {
-            sevirds const& res = state.current_state;
+            // Any of the cell's states has its precision
+            sevirds const& res = *states.front();
 
             // Can't be bigger then 1 or less then 0
             if (value < (0 - res.one_over_prec_divider) || value > (1 + res.one_over_prec_divider))
@@ -794,6 +955,48 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                                 to_string(value) + " is \033[33m" + (value < 0 ? "less then zero" : "bigger then one") + "\033[31m on day " + to_string((int)simulation_clock));
             }
         }
+
+    private:
+        // Every full state this cell has computed. Cadmium's current state and the messages
+        // carrying it share one, so a state is only computed into again once this cell is the
+        // last one holding it (see spare())
+        mutable vector<shared_ptr<sevirds>> states;
+        mutable shared_ptr<sevirds> current; // When stepped with step()
+        mutable shared_ptr<sevirds> next;    // Being computed
+
+        // Hysteresis of each edge of the cell's row. One goes with the current state and the
+        // next day's is computed into the other, they swap when the state is replaced
+        mutable array<vector<hysteresis_factor>, 2> hysteresis;
+        mutable unsigned int hysteresis_slot = 0;
+
+        /**
+         * @brief The state the next day is computed into, one nothing else holds.
+         * A new one is only made when all of them are still held
+         * 
+         * @return sevirds&
+        */
+        sevirds& spare() const
+        {
+            if (!next)
+            {
+                for (shared_ptr<sevirds> const& s : states)
+                {
+                    if (s.use_count() == 1)
+                    {
+                        next = s;
+                        return *next;
+                    }
+                }
+
+                states.push_back(make_shared<sevirds>(*states.front()));
+                next = states.back();
+            }
+            return *next;
+        }
+
+        // Cache for get_neighbor_states(), rebuilt if the cell is ever copied
+        mutable vector<sevirds_public const*> neighbor_states;
+        mutable void const* neighbor_states_owner = nullptr;
 }; //class geographical_cell{}
 
 #endif //PANDEMIC_HOYA_2002_ZHONG_CELL_HPP
\ No newline at end of file
@@ -0,0 +1,96 @@
+#ifndef PANDEMIC_HOYA_2002_LOG_FORMAT_HPP
+#define PANDEMIC_HOYA_2002_LOG_FORMAT_HPP
+
+#include <array>
+#include <locale>
+#include <ostream>
+#include <charconv>
+
+using namespace std;
+
+/**
+ * Writes the values of a state as the state log holds them, <v0,v1,...>, with std::to_chars
+ * into a buffer instead of one ostream insertion per value. ostream writes a double as printf's
+ * %g with the stream's precision and to_chars does the same in the general format, without the
+ * locale and the sentry of each insertion, so the text is the same byte for byte.
+ *
+ * Compilers without to_chars for doubles (GCC before 11) and streams that aren't in the default
+ * format or the classic locale are written through ostream as before.
+*/
+namespace log_format
+{
+    // Enough for 11 values at the precision of a double
+    constexpr size_t BUFFER_SIZE = 512;
+
+    /**
+     * @brief Writes <v0,v1,...> into a buffer
+     *
+     * @param first Start of the buffer
+     * @param last End of the buffer
+     * @param values Values of the state
+     * @param precision Significant digits, as ostream::precision()
+     * @return char* End of the text, nullptr if it didn't fit or to_chars isn't available
+    */
+    template <size_t N>
+    char* to_chars(char* first, char* last, array<double, N> const& values, int precision)
+    {
+#if defined(__cpp_lib_to_chars)
+        if (first == last)
+            return nullptr;
+        *first++ = '<';
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            if (i > 0)
+            {
+                if (first == last)
+                    return nullptr;
+                *first++ = ',';
+            }
+
+            std::to_chars_result result = std::to_chars(first, last, values[i], chars_format::general, precision);
+            if (result.ec != errc())
+                return nullptr;
+            first = result.ptr;
+        }
+
+        if (first == last)
+            return nullptr;
+        *first++ = '>';
+        return first;
+#else
+        (void)first; (void)last; (void)values; (void)precision;
+        return nullptr;
+#endif
+    }
+
+    /**
+     * @brief Writes <v0,v1,...> to a stream as inserting each value would
+     *
+     * @param os Stream written to
+     * @param values Values of the state
+    */
+    template <size_t N>
+    void write(ostream& os, array<double, N> const& values)
+    {
+        // A width, flags or a locale's decimal point are only honoured by inserting the values
+        constexpr ios::fmtflags formatting = ios::floatfield | ios::showpoint | ios::showpos | ios::uppercase;
+        if (os.width() == 0 && (os.flags() & formatting) == 0 && os.getloc() == locale::classic())
+        {
+            char buffer[BUFFER_SIZE];
+            char* end = log_format::to_chars(buffer, buffer + BUFFER_SIZE, values, os.precision());
+            if (end != nullptr)
+            {
+                os.write(buffer, end - buffer);
+                return;
+            }
+        }
+
+        os << "<" << values[0];
+        for (size_t i = 1; i < N; ++i)
+            os << "," << values[i];
+        os << ">";
+    }
+} //namespace log_format
+
+#endif //PANDEMIC_HOYA_2002_LOG_FORMAT_HPP
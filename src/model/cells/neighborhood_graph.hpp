@@ -0,0 +1,147 @@
+#ifndef PANDEMIC_HOYA_2002_NEIGHBORHOOD_GRAPH_HPP
+#define PANDEMIC_HOYA_2002_NEIGHBORHOOD_GRAPH_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+#include "vicinity.hpp"
+#include "correction_table.hpp"
+
+using namespace std;
+
+/**
+ * Adjacency of every cell in the scenario stored as a compressed sparse row table.
+ * Cells get a dense integer id and the neighbors of cell i are the edges
+ * row_offsets[i] ... row_offsets[i + 1] - 1. Every per-edge value lives in a flat
+ * array indexed by the edge so geographical_cell never hashes a cell id while stepping.
+ * Filled by geographical_coupled::add_cell_json() and finalized in couple_cells().
+*/
+struct neighborhood_graph
+{
+    using correction_factors_map = map<vicinity::infection_threshold, vicinity::mobility_correction_factor>;
+
+    vector<string> cell_ids;                   // Dense id -> cell id
+    unordered_map<string, unsigned int> ids;   // Cell id -> dense id
+
+    vector<unsigned int> row_offsets;          // First edge of each cell (size: cells + 1)
+    vector<unsigned int> self_edges;           // Edge from each cell to itself
+
+    // Per-edge data
+    vector<unsigned int> neighbors;            // Dense id of cell j
+    vector<double> correlations;               // cij
+    vector<unsigned int> correction_ids;       // Index in correction_tables, used to compute kij
+
+    // Distinct correction factors of the scenario, most edges share the same few
+    vector<correction_table> correction_tables;
+
+    /**
+     * @brief Returns the dense id of a cell, giving it one if it's the first time it's seen
+     *
+     * @param cell_id Id of the cell in the scenario
+     * @return unsigned int
+    */
+    unsigned int intern(string const& cell_id)
+    {
+        auto it = ids.find(cell_id);
+        if (it != ids.end())
+            return it->second;
+
+        ids.insert({cell_id, (unsigned int)cell_ids.size()});
+        cell_ids.push_back(cell_id);
+        return cell_ids.size() - 1;
+    }
+
+    /**
+     * @brief Records the neighborhood of a cell. The edges keep the iteration order of
+     * the neighborhood so the sums over the neighbors add up in the same order as before
+     *
+     * @param cell_id Id of the cell in the scenario
+     * @param neighborhood Vicinity of each neighbor, including the cell itself
+     * @return unsigned int Dense id of the cell
+    */
+    unsigned int add_cell(string const& cell_id, unordered_map<string, vicinity> const& neighborhood)
+    {
+        unsigned int id = intern(cell_id);
+
+        for (auto const& neighbor : neighborhood)
+        {
+            unsigned int j = intern(neighbor.first);
+            pending.resize(cell_ids.size());
+            pending.at(id).push_back({j, neighbor.second});
+        }
+
+        has_row.resize(cell_ids.size(), false);
+        has_row.at(id) = true;
+        return id;
+    }
+
+    /**
+     * @brief Builds the compressed rows once every cell has been added
+    */
+    void build()
+    {
+        unsigned int num_cells = cell_ids.size();
+        pending.resize(num_cells);
+        has_row.resize(num_cells, false);
+
+        row_offsets.assign(1, 0);
+        self_edges.assign(num_cells, 0);
+        neighbors.clear();
+        correlations.clear();
+        correction_ids.clear();
+        correction_tables.clear();
+
+        map<correction_factors_map, unsigned int> distinct_factors;
+
+        for (unsigned int i = 0; i < num_cells; ++i)
+        {
+            if (!has_row.at(i))
+                throw runtime_error{"The neighbor " + cell_ids.at(i) + " is not a cell in the scenario"};
+
+            bool has_self = false;
+            for (unsigned int e = 0; e < pending.at(i).size(); ++e)
+            {
+                unsigned int j = pending.at(i).at(e).first;
+                vicinity& v    = pending.at(i).at(e).second;
+                if (j == i)
+                {
+                    self_edges.at(i) = neighbors.size();
+                    has_self = true;
+                }
+
+                neighbors.push_back(j);
+                correlations.push_back(v.correlation);
+
+                auto factors = distinct_factors.find(v.correction_factors);
+                if (factors == distinct_factors.end())
+                {
+                    factors = distinct_factors.insert({move(v.correction_factors), (unsigned int)correction_tables.size()}).first;
+                    correction_tables.emplace_back(factors->first);
+                }
+                correction_ids.push_back(factors->second);
+            }
+
+            if (!has_self)
+                throw runtime_error{"The cell " + cell_ids.at(i) + " must be part of its own neighborhood"};
+
+            row_offsets.push_back(neighbors.size());
+        }
+
+        pending.clear();
+        has_row.clear();
+    }
+
+    unsigned int num_cells() const                  { return row_offsets.size() - 1;                    }
+    unsigned int row_begin(unsigned int cell) const { return row_offsets[cell];                         }
+    unsigned int row_end(unsigned int cell) const   { return row_offsets[cell + 1];                     }
+    unsigned int row_size(unsigned int cell) const  { return row_offsets[cell + 1] - row_offsets[cell]; }
+
+    private:
+        // Edges waiting for build(), kept per cell as they can be added in any order
+        vector<vector<pair<unsigned int, vicinity>>> pending;
+        vector<bool> has_row;
+};
+
+#endif //PANDEMIC_HOYA_2002_NEIGHBORHOOD_GRAPH_HPP
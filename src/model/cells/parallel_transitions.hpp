@@ -0,0 +1,186 @@
+#ifndef PANDEMIC_HOYA_2002_PARALLEL_TRANSITIONS_HPP
+#define PANDEMIC_HOYA_2002_PARALLEL_TRANSITIONS_HPP
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "cell_pool.hpp"
+#include "neighborhood_graph.hpp"
+#include "sevirds.hpp"
+
+using namespace std;
+
+template <typename T>
+class geographical_cell;
+
+/**
+ * Parallel execution policy for when the cells are run by Cadmium. Cadmium calls the cells'
+ * local_computation() one at a time, but with an output delay of one day every cell that
+ * transitions on a day does so from the states its neighbors had at the end of the day before.
+ * Those are the neighbors' current states until the first of them transitions, so the first
+ * local_computation() of a day computes the next state of the imminent cells on a pool of
+ * threads. Like Cadmium, only the cells that changed on the day before or have a neighbor that
+ * did are imminent; every cell is on the first day, when they all send their first state.
+ *
+ * Each cell then only takes its precomputed state if what it received from its neighbors is
+ * what the precomputation read from them (see take()). Otherwise it computes the state itself
+ * as usual, so the results, the order of the messages and the logs are the same as without
+ * the policy.
+ *
+ * Usage: set geographical_coupled::transitions before adding the cells
+*/
+template <typename T>
+class parallel_transitions
+{
+    private:
+        using cell_type = geographical_cell<T> const;
+
+        cell_pool<cell_type> pool;
+        typename cell_pool<cell_type>::task compute;
+
+        shared_ptr<neighborhood_graph const> graph;
+        vector<cell_type*> by_index; // Dense id of the graph -> cell, null once it's gone
+        vector<cell_type*> cells;    // The cells of by_index, rebuilt when one comes or goes
+        vector<cell_type*> imminent; // The cells computed ahead on the day
+        bool changed = false;
+
+        vector<sevirds_public> inputs; // One per edge, read when its cell was computed ahead
+        vector<unsigned char> ready;   // One per cell, whether its next state is waiting in its inactive buffer
+        vector<unsigned char> sent;    // One per cell, whether it changed since the last day was computed ahead
+
+        T time{};
+        bool started = false;
+
+        /**
+         * @brief Computes the next state of the imminent cells from the current states of their neighbors
+         *
+         * @param day Simulation time the states are computed for
+        */
+        void compute_ahead(T day)
+        {
+            if (changed)
+            {
+                cells.clear();
+                for (cell_type* cell : by_index)
+                {
+                    if (cell != nullptr)
+                        cells.push_back(cell);
+                }
+                changed = false;
+            }
+
+            // Cadmium runs the cells that received a state, i.e. one in their row changed (see lockstep_runner::find_transitions())
+            sent.resize(graph->num_cells(), 0);
+            imminent.clear();
+            for (cell_type* cell : cells)
+            {
+                bool runs = !started;
+                for (unsigned int e = graph->row_begin(cell->cell_index); e < graph->row_end(cell->cell_index) && !runs; ++e)
+                    runs = sent[graph->neighbors[e]];
+                if (runs)
+                    imminent.push_back(cell);
+            }
+
+            time    = day;
+            started = true;
+            inputs.resize(graph->neighbors.size());
+            ready.assign(by_index.size(), 0);
+            fill(sent.begin(), sent.end(), 0);
+
+            pool.for_each_cell(imminent, compute);
+        }
+
+    public:
+        /**
+         * @param threads Number of threads computing the cells, including Cadmium's
+        */
+        explicit parallel_transitions(unsigned int threads) : pool(threads)
+        {
+            compute = [this](cell_type& cell)
+            {
+                thread_local vector<sevirds_public const*> nstates;
+                nstates.clear();
+                for (unsigned int e = graph->row_begin(cell.cell_index); e < graph->row_end(cell.cell_index); ++e)
+                {
+                    cell_type const* neighbor = by_index[graph->neighbors[e]];
+                    if (neighbor == nullptr)
+                        return;
+
+                    inputs[e] = neighbor->state.current_state;
+                    nstates.push_back(&neighbor->state.current_state);
+                }
+
+                cell.compute_ahead(nstates);
+                ready[cell.cell_index] = 1;
+            };
+        }
+
+        parallel_transitions(parallel_transitions const&) = delete;
+        parallel_transitions& operator=(parallel_transitions const&) = delete;
+
+        // Called by each cell once it's built
+        void enlist(cell_type& cell)
+        {
+            if (!graph)
+                graph = cell.graph;
+            if (cell.cell_index >= by_index.size())
+                by_index.resize(cell.cell_index + 1, nullptr);
+
+            by_index[cell.cell_index] = &cell;
+            changed = true;
+        }
+
+        // Called by each cell when it's destroyed
+        void leave(cell_type& cell)
+        {
+            if (cell.cell_index < by_index.size() && by_index[cell.cell_index] == &cell)
+            {
+                by_index[cell.cell_index] = nullptr;
+                changed = true;
+            }
+        }
+
+        /**
+         * @brief Records that a cell's state changed, so it and its neighbors are imminent the next day.
+         * Only called from Cadmium's thread
+         *
+         * @param cell Cell in its local_computation()
+        */
+        void sends(cell_type& cell)
+        {
+            if (cell.cell_index < sent.size())
+                sent[cell.cell_index] = 1;
+        }
+
+        /**
+         * @brief Whether a cell's next state was computed ahead from the states it has received.
+         * The first call of a day computes the states of that day for the imminent cells.
+         * Only called from Cadmium's thread
+         *
+         * @param cell Cell in its local_computation()
+         * @param nstates States the cell received in the order of its row in the graph
+         * @return bool Whether the state is in the cell's inactive buffer
+        */
+        bool take(cell_type& cell, vector<sevirds_public const*> const& nstates)
+        {
+            if (cell.cell_index >= by_index.size() || by_index[cell.cell_index] != &cell)
+                return false;
+
+            if (!started || cell.simulation_clock != time)
+                compute_ahead(cell.simulation_clock);
+
+            if (!ready[cell.cell_index])
+                return false;
+            ready[cell.cell_index] = 0;
+
+            unsigned int const row_begin = graph->row_begin(cell.cell_index);
+            for (unsigned int e = row_begin; e < graph->row_end(cell.cell_index); ++e)
+            {
+                if (!(inputs[e] == *nstates[e - row_begin]))
+                    return false;
+            }
+            return true;
+        }
+};
+
+#endif //PANDEMIC_HOYA_2002_PARALLEL_TRANSITIONS_HPP
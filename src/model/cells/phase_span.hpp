@@ -0,0 +1,58 @@
+#ifndef PANDEMIC_HOYA_2002_PHASE_SPAN_HPP
+#define PANDEMIC_HOYA_2002_PHASE_SPAN_HPP
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+
+/**
+ * Non-owning view of the phase days of one age group.
+ * The values live in the contiguous buffer of a sevirds object, a rate table
+ * or the AgeData workspace. A span is only valid as long as that buffer isn't reallocated.
+*/
+template <typename V>
+class phase_span
+{
+    private:
+        V* m_data;
+        unsigned int m_size;
+
+    public:
+        phase_span() : m_data(nullptr), m_size(0) { }
+        phase_span(V* data, unsigned int size) : m_data(data), m_size(size) { }
+
+        // Allows a span of doubles to be passed where a read only span is expected
+        template <typename U>
+        phase_span(phase_span<U> const& other) : m_data(other.data()), m_size(other.size()) { }
+
+        // Views a whole vector, e.g. one age group of a rate table
+        template <typename U>
+        phase_span(std::vector<U>& values) : m_data(values.data()), m_size(values.size()) { }
+        template <typename U>
+        phase_span(std::vector<U> const& values) : m_data(values.data()), m_size(values.size()) { }
+
+        unsigned int size() const { return m_size;      }
+        bool empty() const        { return m_size == 0; }
+        V* data() const           { return m_data;      }
+
+        V* begin() const { return m_data;          }
+        V* end() const   { return m_data + m_size; }
+
+        V& front() const { return m_data[0];          }
+        V& back() const  { return m_data[m_size - 1]; }
+
+        V& operator[](unsigned int i) const { return m_data[i]; }
+
+        // Bounds checked like vector::at()
+        V& at(unsigned int i) const
+        {
+            if (i >= m_size)
+                throw std::out_of_range{"phase_span::at: index " + std::to_string(i) + " >= size " + std::to_string(m_size)};
+            return m_data[i];
+        }
+};
+
+using phase_view       = phase_span<double>;
+using const_phase_view = phase_span<double const>;
+
+#endif //PANDEMIC_HOYA_2002_PHASE_SPAN_HPP
@@ -0,0 +1,197 @@
+#ifndef PANDEMIC_HOYA_2002_RATE_TABLES_HPP
+#define PANDEMIC_HOYA_2002_RATE_TABLES_HPP
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include "simulation_config.hpp"
+#include "phase_span.hpp"
+#include "transmission_kernels.hpp"
+
+using namespace std;
+
+/**
+ * The epidemiological rates used by a cell. They never change during a simulation
+ * and most cells of a scenario use the same ones, so each distinct set is only
+ * stored once and shared by every cell using it (see rate_tables_registry).
+*/
+struct rate_tables
+{
+    using phase_rates = vector<          // The age sub_division
+                        vector<double>>; // The stage of infection
+
+    phase_rates virulence_rates;
+    phase_rates incubation_rates;
+    phase_rates incubationD1_rates;
+    phase_rates incubationD2_rates;
+    phase_rates recovery_rates;
+    phase_rates recoveryD1_rates;
+    phase_rates recoveryD2_rates;
+    phase_rates mobility_rates;
+    phase_rates fatality_rates;
+    phase_rates fatalityD1_rates;
+    phase_rates fatalityD2_rates;
+    phase_rates vac1_rates;
+    phase_rates vac2_rates;
+
+    // μ(n) * λ(n) of every age group, each row zero padded to a multiple of transmission_kernels::WIDTH
+    // so they all start aligned. Derived from the rates by fuse(), it isn't hashed, compared or stored
+    vector<double, transmission_kernels::aligned_allocator<double>> fused_weights;
+    vector<unsigned int> fused_sizes; // Phase days of each row
+    unsigned int fused_stride = 0;    // Doubles between the rows
+
+    rate_tables() = default;
+
+    /**
+     * @brief Moves the rates out of a parsed config. The vaccinated rates are only
+     * kept when vaccines are being modelled
+     *
+     * @param config Config of the cell, its rates are left empty
+    */
+    explicit rate_tables(simulation_config& config) :
+        virulence_rates(move(config.virulence_rates)),
+        incubation_rates(move(config.incubation_rates)),
+        recovery_rates(move(config.recovery_rates)),
+        mobility_rates(move(config.mobility_rates)),
+        fatality_rates(move(config.fatality_rates))
+    {
+        if (config.is_vaccination)
+        {
+            vac1_rates = move(config.vac1_rates);
+            vac2_rates = move(config.vac2_rates);
+
+            incubationD1_rates = move(config.incubationD1_rates);
+            incubationD2_rates = move(config.incubationD2_rates);
+
+            recoveryD1_rates = move(config.recovery_ratesD1);
+            recoveryD2_rates = move(config.recovery_ratesD2);
+
+            fatalityD1_rates = move(config.fatality_ratesD1);
+            fatalityD2_rates = move(config.fatality_ratesD2);
+        }
+    }
+
+    /**
+     * @brief Premultiplies the mobility and virulence rates of each age group and phase day
+    */
+    void fuse()
+    {
+        unsigned int age_groups = min(mobility_rates.size(), virulence_rates.size());
+
+        fused_sizes.assign(age_groups, 0);
+        for (unsigned int a = 0; a < age_groups; ++a)
+            fused_sizes[a] = min(mobility_rates[a].size(), virulence_rates[a].size());
+
+        unsigned int widest = age_groups > 0 ? *max_element(fused_sizes.begin(), fused_sizes.end()) : 0;
+        unsigned int width  = transmission_kernels::WIDTH;
+        fused_stride = (widest + width - 1) / width * width;
+
+        fused_weights.assign(age_groups * fused_stride, 0.0);
+        for (unsigned int a = 0; a < age_groups; ++a)
+        {
+            for (unsigned int n = 0; n < fused_sizes[a]; ++n)
+                fused_weights[a * fused_stride + n] = mobility_rates[a][n] * virulence_rates[a][n];
+        }
+    }
+
+    /**
+     * @brief μ(n) * λ(n) of an age group, aligned for transmission_kernels::dot()
+     *
+     * @param age_group Age group index
+     * @return const_phase_view
+    */
+    const_phase_view transmission_weights(unsigned int age_group) const
+    {
+        return const_phase_view(fused_weights.data() + age_group * fused_stride, fused_sizes.at(age_group));
+    }
+
+    // Every table in the order they're hashed, compared and stored in a scenario image
+    array<phase_rates const*, 13> tables() const
+    {
+        return { &virulence_rates, &incubation_rates, &incubationD1_rates, &incubationD2_rates,
+                 &recovery_rates, &recoveryD1_rates, &recoveryD2_rates, &mobility_rates,
+                 &fatality_rates, &fatalityD1_rates, &fatalityD2_rates, &vac1_rates, &vac2_rates };
+    }
+
+    array<phase_rates*, 13> tables()
+    {
+        array<phase_rates const*, 13> read_only = static_cast<rate_tables const&>(*this).tables();
+        array<phase_rates*, 13> writable;
+        for (unsigned int i = 0; i < read_only.size(); ++i)
+            writable[i] = const_cast<phase_rates*>(read_only[i]);
+        return writable;
+    }
+
+    /**
+     * @brief Hash of every rate, including the shape of the tables
+     *
+     * @return size_t
+    */
+    size_t hash() const
+    {
+        size_t seed = 0;
+        auto combine = [&seed](size_t value) { seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2); };
+
+        for (phase_rates const* table : tables())
+        {
+            combine(table->size());
+            for (vector<double> const& age_group : *table)
+            {
+                combine(age_group.size());
+                for (double rate : age_group)
+                    combine(std::hash<double>{}(rate));
+            }
+        }
+
+        return seed;
+    }
+
+    bool operator==(rate_tables const& other) const
+    {
+        array<phase_rates const*, 13> mine = tables(), theirs = other.tables();
+        for (unsigned int i = 0; i < mine.size(); ++i)
+        {
+            if (*mine[i] != *theirs[i])
+                return false;
+        }
+        return true;
+    }
+};
+
+/**
+ * Hands out one shared copy of each distinct set of rate tables.
+ * Filled by geographical_coupled::add_cell_json() while the scenario is loaded.
+*/
+class rate_tables_registry
+{
+    private:
+        // Hash -> tables with that hash (more than one only on a collision)
+        unordered_map<size_t, vector<shared_ptr<rate_tables const>>> interned;
+
+    public:
+        /**
+         * @brief Returns the shared tables with the same rates, adding them if they're new
+         *
+         * @param rates Rates of a cell
+         * @return shared_ptr<rate_tables const>
+        */
+        shared_ptr<rate_tables const> intern(rate_tables&& rates)
+        {
+            vector<shared_ptr<rate_tables const>>& bucket = interned[rates.hash()];
+            for (shared_ptr<rate_tables const> const& shared : bucket)
+            {
+                if (*shared == rates)
+                    return shared;
+            }
+
+            // Tables derived from the rates are only built once per distinct set
+            rates.fuse();
+            bucket.push_back(make_shared<rate_tables const>(move(rates)));
+            return bucket.back();
+        }
+};
+
+#endif //PANDEMIC_HOYA_2002_RATE_TABLES_HPP
@@ -5,66 +5,111 @@
 #define PANDEMIC_HOYA_2002_SEIRD_HPP
 
 #include <iostream>
+#include <array>
+#include <memory>
+#include <numeric>
+#include <cstdint>
+#include <cstring>
 #include <nlohmann/json.hpp>
-#include "hysteresis_factor.hpp"
+#include "phase_span.hpp"
+#include "log_format.hpp"
 #include "../Helpers/Assert.hpp"
 
 using namespace std;
 using namespace Assert;
 
+/**
+ * The part of a state its neighbors read, what the force of infection needs from each of them
+ * (see geographical_cell::force_of_infection()). Published by the cell once a state is
+ * computed (see geographical_cell::publish()) so the neighbors don't each recompute it.
+*/
+struct sevirds_public
+{
+    double disobedient      = 0;
+    double infectiousness   = 0; // sum(bϵ{1...A} and nϵ{1...Ti}[μ(n) * λ(n) * I(n) * Njb / Nj])
+    double total_infections = 0; // get_total_infections()
+
+    bool operator==(sevirds_public const& other) const
+    {
+        return disobedient == other.disobedient && infectiousness == other.infectiousness && total_infections == other.total_infections;
+    }
+};
+
+/**
+ * Totals of a state over every age group, weighted by the age group proportions.
+ * Summed once by sevirds::summarize() when the state is done being computed so
+ * reading them costs nothing.
+*/
+struct sevirds_totals
+{
+    double susceptible    = 0; // Not vaccinated, get_total_susceptible(true)
+    double vaccinatedD1   = 0;
+    double vaccinatedD2   = 0;
+    double exposed        = 0;
+    double infections     = 0;
+    double recovered      = 0;
+    double fatalities     = 0;
+
+    // On the first day of their phase
+    double new_exposed    = 0;
+    double new_infections = 0;
+    double new_recoveries = 0;
+};
+
 /**
  * Keeps track of the model data and is initially
  * populated by what is store under the "state"
  * param found in default.json.
+ *
+ * Every compartment is stored in one contiguous buffer
+ * (structure of arrays) so copying a state is a single
+ * memcpy and the per-age scans read contiguous memory.
 */
-struct sevirds
+struct sevirds : sevirds_public
 {
     using proportionVector = vector<vector<double>>;    // { {doubles}, {doubles},   ......... }
                                                         //   ageGroup1  ageGroup2    ageGroup#
 
-    double population;
-    vector<double> age_group_proportions;
-
-    // Susceptible
-    proportionVector susceptible;
-    proportionVector vaccinatedD1;
-    proportionVector vaccinatedD2;
-
-    // Exposed
-    proportionVector exposed;
-    proportionVector exposedD1;
-    proportionVector exposedD2;
+    // Blocks of the buffer. Each one holds num_age_groups rows of the same number of phase days.
+    enum compartment
+    {
+        AGE_GROUP_PROPORTIONS,
+        SUSCEPTIBLE, VACCINATED_D1, VACCINATED_D2,
+        EXPOSED,     EXPOSED_D1,    EXPOSED_D2,
+        INFECTED,    INFECTED_D1,   INFECTED_D2,
+        RECOVERED,   RECOVERED_D1,  RECOVERED_D2,
+        FATALITIES,
+        IMMUNITY_D1, IMMUNITY_D2,
+        NUM_COMPARTMENTS
+    };
 
-    // Infected
-    proportionVector infected;
-    proportionVector infectedD1;
-    proportionVector infectedD2;
+    // Where a compartment starts in the buffer and how many phase days each of its age groups has
+    struct block
+    {
+        unsigned int offset = 0;
+        unsigned int phases = 0;
+    };
 
-    // Recovered
-    proportionVector recovered;
-    proportionVector recoveredD1;
-    proportionVector recoveredD2;
+    double population;
 
-    // Fatalities
-    vector<double> fatalities;
+    vector<double> buffer;
+    array<block, NUM_COMPARTMENTS> layout;
 
-    // Modifiers
-    double disobedient;
+    // Modifiers (disobedient is public)
     double hospital_capacity;
     double fatality_modifier;
 
     // Vaccines
-    proportionVector immunityD1_rate;
-    proportionVector immunityD2_rate;
     unsigned int min_interval_doses;
     unsigned int min_interval_recovery_to_vaccine;
 
-    unordered_map<string, hysteresis_factor> hysteresis_factors;
     unsigned int num_age_groups;
 
     bool vaccines;       // Are vaccines being modelled?
     double prec_divider; // Precision divider
 
+    sevirds_totals totals; // Up to date once summarize() is called
+
     // 1 divided by precision divider
     // Divisions cost more then multiplication
     // so do it once at the start then multiply by the decimal value
@@ -74,6 +119,7 @@ struct sevirds
     // The overloaded constructor results in a default constructor having to be manually written.
     sevirds()
     {
+        num_age_groups        = 0;
         vaccines              = false;
         prec_divider          = 0;
         one_over_prec_divider = 0;
@@ -85,52 +131,156 @@ struct sevirds
             proportionVector rec, proportionVector rec1, proportionVector rec2,
             vector<double> fat, double dis, double hcap, double fatm, proportionVector immuD1, unsigned int min_interval,
             proportionVector immuD2, double divider, bool vac=false) :
-                susceptible{move(sus)},
-                vaccinatedD1{move(vac1)},
-                vaccinatedD2{move(vac2)},
-                exposed{move(exp)},
-                exposedD1{move(exp1)},
-                exposedD2(move(exp2)),
-                infected{move(inf)},
-                infectedD1{move(inf1)},
-                infectedD2{move(inf2)},
-                recovered{move(rec)},
-                recoveredD1{move(rec1)},
-                recoveredD2{move(rec2)},
-                fatalities{move(fat)},
-                disobedient{dis},
                 hospital_capacity{hcap},
                 fatality_modifier{fatm},
-                immunityD1_rate{move(immuD1)},
-                immunityD2_rate{move(immuD2)},
                 min_interval_doses{min_interval},
+                num_age_groups(sus.size()),
                 vaccines(vac),
                 prec_divider(divider),
                 one_over_prec_divider(1.0 / divider)
-    { num_age_groups = age_group_proportions.size(); }
+    {
+        disobedient = dis;
+
+        proportionVector fatalities;
+        for (double f : fat)
+            fatalities.push_back({f});
+
+        pack({ proportionVector(num_age_groups, {0.0}), sus, vac1, vac2, exp, exp1, exp2,
+                inf, inf1, inf2, rec, rec1, rec2, fatalities, immuD1, immuD2 });
+    }
+
+    /**
+     * @brief Sizes the buffer for the given number of phase days per compartment.
+     * The values are all set to zero.
+     *
+     * @param phases Number of phase days of each compartment (see enum compartment)
+    */
+    void allocate(array<unsigned int, NUM_COMPARTMENTS> const& phases)
+    {
+        unsigned int offset = 0;
+        for (unsigned int c = 0; c < NUM_COMPARTMENTS; ++c)
+        {
+            layout[c].offset = offset;
+            layout[c].phases = phases[c];
+            offset += phases[c] * num_age_groups;
+        }
+
+        buffer.assign(offset, 0.0);
+    }
+
+    /**
+     * @brief Copies nested vectors into the buffer. Only the first num_age_groups rows are kept
+     * and every row of a compartment must have the same number of phase days.
+     *
+     * @param compartments One proportionVector per compartment in the order of enum compartment
+    */
+    void pack(array<proportionVector, NUM_COMPARTMENTS> const& compartments)
+    {
+        array<unsigned int, NUM_COMPARTMENTS> phases;
+        for (unsigned int c = 0; c < NUM_COMPARTMENTS; ++c)
+        {
+            AssertLong(num_age_groups <= compartments[c].size(), __FILE__, __LINE__,
+                        "There must be at least " + to_string(num_age_groups) + " age groups for each of the lists under the 'states' parameter in default.json as well as in infectedCell.json");
+
+            phases[c] = num_age_groups > 0 ? compartments[c].front().size() : 0;
+        }
+
+        allocate(phases);
+
+        for (unsigned int c = 0; c < NUM_COMPARTMENTS; ++c)
+        {
+            for (unsigned int a = 0; a < num_age_groups; ++a)
+            {
+                vector<double> const& row = compartments[c].at(a);
+                AssertLong(row.size() == phases[c], __FILE__, __LINE__,
+                            "Every age group of a state vector must have the same number of days. Double check the values in default.json AND infectedCell.json");
+
+                copy(row.begin(), row.end(), buffer.begin() + layout[c].offset + a * phases[c]);
+            }
+        }
+    }
+
+    /**
+     * @brief The phase days of one age group in a compartment
+     *
+     * @param c Compartment
+     * @param age_group Age group index
+     * @return phase_view
+    */
+    phase_view get(compartment c, unsigned int age_group)
+    {
+        return phase_view(buffer.data() + layout[c].offset + age_group * layout[c].phases, layout[c].phases);
+    }
+
+    const_phase_view get(compartment c, unsigned int age_group) const
+    {
+        return const_phase_view(buffer.data() + layout[c].offset + age_group * layout[c].phases, layout[c].phases);
+    }
+
+    // Susceptible
+    phase_view susceptible(unsigned int a)              { return get(SUSCEPTIBLE, a);   }
+    phase_view vaccinatedD1(unsigned int a)             { return get(VACCINATED_D1, a); }
+    phase_view vaccinatedD2(unsigned int a)             { return get(VACCINATED_D2, a); }
+    const_phase_view susceptible(unsigned int a) const  { return get(SUSCEPTIBLE, a);   }
+    const_phase_view vaccinatedD1(unsigned int a) const { return get(VACCINATED_D1, a); }
+    const_phase_view vaccinatedD2(unsigned int a) const { return get(VACCINATED_D2, a); }
+
+    // Exposed
+    phase_view exposed(unsigned int a)                  { return get(EXPOSED, a);       }
+    phase_view exposedD1(unsigned int a)                { return get(EXPOSED_D1, a);    }
+    phase_view exposedD2(unsigned int a)                { return get(EXPOSED_D2, a);    }
+    const_phase_view exposed(unsigned int a) const      { return get(EXPOSED, a);       }
+    const_phase_view exposedD1(unsigned int a) const    { return get(EXPOSED_D1, a);    }
+    const_phase_view exposedD2(unsigned int a) const    { return get(EXPOSED_D2, a);    }
+
+    // Infected
+    phase_view infected(unsigned int a)                 { return get(INFECTED, a);      }
+    phase_view infectedD1(unsigned int a)               { return get(INFECTED_D1, a);   }
+    phase_view infectedD2(unsigned int a)               { return get(INFECTED_D2, a);   }
+    const_phase_view infected(unsigned int a) const     { return get(INFECTED, a);      }
+    const_phase_view infectedD1(unsigned int a) const   { return get(INFECTED_D1, a);   }
+    const_phase_view infectedD2(unsigned int a) const   { return get(INFECTED_D2, a);   }
+
+    // Recovered
+    phase_view recovered(unsigned int a)                { return get(RECOVERED, a);     }
+    phase_view recoveredD1(unsigned int a)              { return get(RECOVERED_D1, a);  }
+    phase_view recoveredD2(unsigned int a)              { return get(RECOVERED_D2, a);  }
+    const_phase_view recovered(unsigned int a) const    { return get(RECOVERED, a);     }
+    const_phase_view recoveredD1(unsigned int a) const  { return get(RECOVERED_D1, a);  }
+    const_phase_view recoveredD2(unsigned int a) const  { return get(RECOVERED_D2, a);  }
+
+    // Vaccines (one value per week)
+    const_phase_view immunityD1_rate(unsigned int a) const { return get(IMMUNITY_D1, a); }
+    const_phase_view immunityD2_rate(unsigned int a) const { return get(IMMUNITY_D2, a); }
+
+    // Fatalities and proportions only have one value per age group
+    double& fatalities(unsigned int a)                   { return buffer[layout[FATALITIES].offset + a];            }
+    double fatalities(unsigned int a) const              { return buffer[layout[FATALITIES].offset + a];            }
+    double age_group_proportion(unsigned int a) const    { return buffer[layout[AGE_GROUP_PROPORTIONS].offset + a]; }
 
     // GETTERS
-    unsigned int get_num_age_segments() const       { return num_age_groups;                }
-    unsigned int get_num_exposed_phases() const     { return exposed.front().size();        }
-    unsigned int get_num_infected_phases() const    { return infected.front().size();       }
-    unsigned int get_num_recovered_phases() const   { return recovered.front().size();      }
-    unsigned int get_num_vaccinated1_phases() const { return vaccinatedD1.front().size();   }
-    unsigned int get_num_vaccinated2_phases() const { return vaccinatedD2.front().size();   }
-    unsigned int get_immunity1_num_weeks() const    { return immunityD1_rate.size();        }
-    unsigned int get_immunity2_num_weeks() const    { return immunityD2_rate.size();        }
+    unsigned int get_num_age_segments() const       { return num_age_groups;                 }
+    unsigned int get_num_exposed_phases() const     { return layout[EXPOSED].phases;         }
+    unsigned int get_num_infected_phases() const    { return layout[INFECTED].phases;        }
+    unsigned int get_num_recovered_phases() const   { return layout[RECOVERED].phases;       }
+    unsigned int get_num_vaccinated1_phases() const { return layout[VACCINATED_D1].phases;   }
+    unsigned int get_num_vaccinated2_phases() const { return layout[VACCINATED_D2].phases;   }
+    unsigned int get_immunity1_num_weeks() const    { return layout[IMMUNITY_D1].phases;     }
+    unsigned int get_immunity2_num_weeks() const    { return layout[IMMUNITY_D2].phases;     }
 
     /**
      * @brief Sums all the values in a vector
-     * 
+     *
      * @param state_vector Vector to be summed
      * @return double
     */
-    static double sum_state_vector(const vector<double>& state_vector) { return accumulate(state_vector.begin(), state_vector.end(), 0.0); }
+    template <typename V>
+    static double sum_state_vector(V const& state_vector) { return accumulate(state_vector.begin(), state_vector.end(), 0.0); }
 
     /**
      * @brief Get the total susceptible population count. This includes those who are
      * vaccinated unless specified with the bool.
-     * 
+     *
      * @param getNVac Used when only wanting to get the non-vaccinated susceptible population.
      * @return double
     */
@@ -144,24 +294,24 @@ struct sevirds
             for (unsigned int i = 0; i < num_age_groups; ++i)
             {
                 // Total non-vaccinated
-                total_susceptible += susceptible.at(i).front() * age_group_proportions.at(i);
+                total_susceptible += susceptible(i).front() * age_group_proportion(i);
 
                 // Total vaccianted (Dose1 + Dose2)
                 if (vaccines && !getNVac)
                 {
-                    total_susceptible += sum_state_vector(vaccinatedD1.at(i)) * age_group_proportions.at(i);
-                    total_susceptible += sum_state_vector(vaccinatedD2.at(i)) * age_group_proportions.at(i);
+                    total_susceptible += sum_state_vector(vaccinatedD1(i)) * age_group_proportion(i);
+                    total_susceptible += sum_state_vector(vaccinatedD2(i)) * age_group_proportion(i);
                 }
             }
         }
         else
         {
-            total_susceptible = susceptible.at(age_group).front();
+            total_susceptible = susceptible(age_group).front();
 
             if (vaccines)
             {
-                total_susceptible += sum_state_vector(vaccinatedD1.at(age_group));
-                total_susceptible += sum_state_vector(vaccinatedD2.at(age_group));
+                total_susceptible += sum_state_vector(vaccinatedD1(age_group));
+                total_susceptible += sum_state_vector(vaccinatedD2(age_group));
             }
         }
 
@@ -170,9 +320,9 @@ struct sevirds
 
     /**
      * @brief Gets the total susceptible group with their first dose
-     * 
+     *
      * @param age_group Will only return the total for that age group
-     * @return double 
+     * @return double
      */
     double get_total_vaccinatedD1(int age_group=-1) const
     {
@@ -183,20 +333,20 @@ struct sevirds
             for (unsigned int i = 0; i < num_age_groups; ++i)
             {
                 // Total vaccinated Dose 1
-                total_vaccinatedD1 += sum_state_vector(vaccinatedD1.at(i)) * age_group_proportions.at(i);
+                total_vaccinatedD1 += sum_state_vector(vaccinatedD1(i)) * age_group_proportion(i);
             }
         }
         else
-            total_vaccinatedD1 = sum_state_vector(vaccinatedD1.at(age_group));
+            total_vaccinatedD1 = sum_state_vector(vaccinatedD1(age_group));
 
         return total_vaccinatedD1;
     }
 
     /**
      * @brief Gets the total susceptible group with their second dose
-     * 
+     *
      * @param age_group Returns the total for those in that age group
-     * @return double 
+     * @return double
      */
     double get_total_vaccinatedD2(int age_group=-1) const
     {
@@ -207,20 +357,20 @@ struct sevirds
             for (unsigned int i = 0; i < num_age_groups; ++i)
             {
                 // Total vaccinated Dose 2
-                total_vaccinatedD2 += sum_state_vector(vaccinatedD2.at(i)) * age_group_proportions.at(i);
+                total_vaccinatedD2 += sum_state_vector(vaccinatedD2(i)) * age_group_proportion(i);
             }
         }
         else
-            total_vaccinatedD2 = sum_state_vector(vaccinatedD2.at(age_group));
+            total_vaccinatedD2 = sum_state_vector(vaccinatedD2(age_group));
 
         return total_vaccinatedD2;
     }
 
     /**
      * @brief Gets the total of those exposed including those vaccinated
-     * 
-     * @param age_group Returns only the total for the specified age group 
-     * @return double 
+     *
+     * @param age_group Returns only the total for the specified age group
+     * @return double
      */
     double get_total_exposed(int age_group=-1) const
     {
@@ -231,24 +381,24 @@ struct sevirds
             for (unsigned int i = 0; i < num_age_groups; ++i)
             {
                 // Total non-vaccinated exposed
-                total_exposed += sum_state_vector(exposed.at(i)) * age_group_proportions.at(i);
+                total_exposed += sum_state_vector(exposed(i)) * age_group_proportion(i);
 
                 // Total vaccinated exposed (Dose1 + Dose2)
                 if (vaccines)
                 {
-                    total_exposed += sum_state_vector(exposedD1.at(i)) * age_group_proportions.at(i);
-                    total_exposed += sum_state_vector(exposedD2.at(i)) * age_group_proportions.at(i);
+                    total_exposed += sum_state_vector(exposedD1(i)) * age_group_proportion(i);
+                    total_exposed += sum_state_vector(exposedD2(i)) * age_group_proportion(i);
                 }
             }
         }
         else
         {
-            total_exposed += sum_state_vector(exposed.at(age_group));
+            total_exposed += sum_state_vector(exposed(age_group));
 
             if (vaccines)
             {
-                total_exposed += sum_state_vector(exposedD1.at(age_group));
-                total_exposed += sum_state_vector(exposedD2.at(age_group));
+                total_exposed += sum_state_vector(exposedD1(age_group));
+                total_exposed += sum_state_vector(exposedD2(age_group));
             }
         }
 
@@ -257,9 +407,9 @@ struct sevirds
 
     /**
      * @brief Returns the total infected population inlcuding those who are vaccinated
-     * 
+     *
      * @param age_group Specifies the age group to compute the total
-     * @return double 
+     * @return double
      */
     double get_total_infections(int age_group=-1) const
     {
@@ -270,24 +420,24 @@ struct sevirds
             for (unsigned int i = 0; i < num_age_groups; ++i)
             {
                 // Total non-vaccinated infected
-                total_infections += sum_state_vector(infected.at(i)) * age_group_proportions.at(i);
+                total_infections += sum_state_vector(infected(i)) * age_group_proportion(i);
 
                 // Total vaccinated infected (Dose1 + Dose2)
                 if (vaccines)
                 {
-                    total_infections += sum_state_vector(infectedD1.at(i)) * age_group_proportions.at(i);
-                    total_infections += sum_state_vector(infectedD2.at(i)) * age_group_proportions.at(i);
+                    total_infections += sum_state_vector(infectedD1(i)) * age_group_proportion(i);
+                    total_infections += sum_state_vector(infectedD2(i)) * age_group_proportion(i);
                 }
             }
         }
         else
         {
-            total_infections += sum_state_vector(infected.at(age_group));
+            total_infections += sum_state_vector(infected(age_group));
 
             if (vaccines)
             {
-                total_infections += sum_state_vector(infectedD1.at(age_group));
-                total_infections += sum_state_vector(infectedD2.at(age_group));
+                total_infections += sum_state_vector(infectedD1(age_group));
+                total_infections += sum_state_vector(infectedD2(age_group));
             }
         }
 
@@ -297,9 +447,9 @@ struct sevirds
     /**
      * @brief Returns the total number of those in the recovery phase
      * including those who are vaccinated
-     * 
+     *
      * @param age_group Returns the total for the specified age group
-     * @return double 
+     * @return double
      */
     double get_total_recovered(int age_group=-1) const
     {
@@ -310,24 +460,24 @@ struct sevirds
             for(unsigned int i = 0; i < num_age_groups; ++i)
             {
                 // Total non-vaccinated recoveries
-                total_recoveries += sum_state_vector(recovered.at(i)) * age_group_proportions.at(i);
+                total_recoveries += sum_state_vector(recovered(i)) * age_group_proportion(i);
 
                 // Total vaccinated recoveries (Dose1 + Dose2)
                 if (vaccines)
                 {
-                    total_recoveries += sum_state_vector(recoveredD1.at(i)) * age_group_proportions.at(i);
-                    total_recoveries += sum_state_vector(recoveredD2.at(i)) * age_group_proportions.at(i);
+                    total_recoveries += sum_state_vector(recoveredD1(i)) * age_group_proportion(i);
+                    total_recoveries += sum_state_vector(recoveredD2(i)) * age_group_proportion(i);
                 }
             }
         }
         else
         {
-            total_recoveries += sum_state_vector(recovered.at(age_group));
+            total_recoveries += sum_state_vector(recovered(age_group));
 
             if (vaccines)
             {
-                total_recoveries += sum_state_vector(recoveredD1.at(age_group));
-                total_recoveries += sum_state_vector(recoveredD2.at(age_group));
+                total_recoveries += sum_state_vector(recoveredD1(age_group));
+                total_recoveries += sum_state_vector(recoveredD2(age_group));
             }
         }
 
@@ -336,31 +486,122 @@ struct sevirds
 
     /**
      * @brief Returns the total fataltities
-     * 
-     * @return double 
+     *
+     * @return double
      */
     double get_total_fatalities() const
     {
         double total_fatalities = 0.0f;
 
         for (unsigned int i = 0; i < num_age_groups; ++i)
-            total_fatalities += fatalities.at(i) * age_group_proportions.at(i);
+            total_fatalities += fatalities(i) * age_group_proportion(i);
 
         return total_fatalities;
     }
 
-    bool operator!=(const sevirds& other) const
+    /**
+     * @brief Sums the totals of the state, called once its compartments have their final values
+     * (see geographical_cell::publish())
+    */
+    void summarize()
     {
-        return  (susceptible != other.susceptible) || (vaccinatedD1 != other.vaccinatedD1) || (vaccinatedD2 != other.vaccinatedD2) ||
-                (exposed != other.exposed) || (exposedD1 != other.exposedD1) || (exposedD2 != other.exposedD2) ||
-                (infected != other.infected) || (infectedD1 != other.infectedD1) || (infectedD2 != other.infectedD2) ||
-                (recovered != other.recovered) || (recoveredD1 != other.recoveredD1) || (recoveredD2 != other.recoveredD2) ||
-                (fatalities != other.fatalities);
+        totals.susceptible = get_total_susceptible(true);
+        totals.exposed     = get_total_exposed();
+        totals.infections  = get_total_infections();
+        totals.recovered   = get_total_recovered();
+        totals.fatalities  = get_total_fatalities();
+
+        totals.vaccinatedD1 = 0.0;
+        totals.vaccinatedD2 = 0.0;
+        if (vaccines)
+        {
+            totals.vaccinatedD1 = get_total_vaccinatedD1();
+            totals.vaccinatedD2 = get_total_vaccinatedD2();
+        }
+
+        double new_exposed = 0, new_infections = 0, new_recoveries = 0;
+
+        // The new exposures, infections and recoveries are on the first day of each respective phase
+        for (unsigned int i = 0; i < num_age_groups; ++i)
+        {
+            double proportion = age_group_proportion(i);
+
+            // Non-Vaccinated
+            new_exposed    += exposed(i).front()   * proportion;
+            new_infections += infected(i).front()  * proportion;
+            new_recoveries += recovered(i).front() * proportion;
+
+            // Vaccinated
+            if (vaccines)
+            {
+                // Dose 1
+                new_exposed    += exposedD1(i).front()   * proportion;
+                new_infections += infectedD1(i).front()  * proportion;
+                new_recoveries += recoveredD1(i).front() * proportion;
+
+                // Dose 2
+                new_exposed    += exposedD2(i).front()   * proportion;
+                new_infections += infectedD2(i).front()  * proportion;
+                new_recoveries += recoveredD2(i).front() * proportion;
+            }
+        }
+
+        totals.new_exposed    = new_exposed;
+        totals.new_infections = new_infections;
+        totals.new_recoveries = new_recoveries;
+    }
+
+    // The age group proportions and immunity rates never change during a simulation
+    // so comparing the whole buffer is the same as comparing every compartment
+    bool operator!=(const sevirds& other) const { return buffer != other.buffer; }
+
+    // Number of values in a line of the state log, see log_values()
+    static constexpr unsigned int NUM_LOG_VALUES = 11;
+
+    /**
+     * @brief The values a state is logged as: the population and then each total with the precision
+     * of the scenario, <population, S, E, VD1, VD2, I, R, new E, new I, new R, D>
+     *
+     * @return array<double, NUM_LOG_VALUES>
+    */
+    array<double, NUM_LOG_VALUES> log_values() const
+    {
+        return { population,
+                 precision_divider(totals.susceptible),
+                 precision_divider(totals.exposed),
+                 precision_divider(totals.vaccinatedD1),
+                 precision_divider(totals.vaccinatedD2),
+                 precision_divider(totals.infections),
+                 precision_divider(totals.recovered),
+                 precision_divider(totals.new_exposed),
+                 precision_divider(totals.new_infections),
+                 precision_divider(totals.new_recoveries),
+                 precision_divider(totals.fatalities) };
+    }
+
+    /**
+     * @brief Hashes the values of a log line so two states can be told apart by one comparison.
+     * States with different lines have the same fingerprint with a chance of 1 in 2^64
+     *
+     * @param values See log_values()
+     * @return uint64_t
+    */
+    static uint64_t fingerprint(array<double, NUM_LOG_VALUES> const& values)
+    {
+        uint64_t hash = 0x9E3779B97F4A7C15ULL;
+        for (double value : values)
+        {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            hash = (hash ^ bits) * 0xFF51AFD7ED558CCDULL;
+            hash ^= hash >> 32;
+        }
+        return hash;
     }
 
     /**
      * @brief Handles setting the desired decimal point without using division
-     * 
+     *
      * @param proportion Value to be corrected
      * @return double
      */
@@ -369,144 +610,117 @@ struct sevirds
 
 /**
  * @brief Outputs <population, S, E, VD1, VD2, I, R, new E, new I, new R, D>
- * 
+ * from the totals of the last summarize()
+ *
  * @param os Out stream object to pipe into
  * @param sevirds Current simulation data
- * @return ostream& 
+ * @return ostream&
  */
 ostream &operator<<(ostream& os, const sevirds& sevirds)
 {
-    double new_exposed    = 0;
-    double new_infections = 0;
-    double new_recoveries = 0;
-
-    double age_group_proportion;
-
-    // Calculate the new exposures, infectsions and recoveries
-    // on the first day of each respective phase
-    for (unsigned int i = 0; i < sevirds.num_age_groups; ++i)
-    {
-        // Get the age group
-        age_group_proportion = sevirds.age_group_proportions.at(i);
-
-        // Non-Vaccinated
-        new_exposed    += sevirds.exposed.at(i).front()   * age_group_proportion; // Exposed
-        new_infections += sevirds.infected.at(i).front()  * age_group_proportion; // Infected
-        new_recoveries += sevirds.recovered.at(i).front() * age_group_proportion; // Recovered
-
-        // Vaccinated
-        if (sevirds.vaccines)
-        {
-            // Dose 1
-            new_exposed    += sevirds.exposedD1.at(i).front()   * age_group_proportion;
-            new_infections += sevirds.infectedD1.at(i).front()  * age_group_proportion;
-            new_recoveries += sevirds.recoveredD1.at(i).front() * age_group_proportion;
-
-            // Dose 2
-            new_exposed    += sevirds.exposedD2.at(i).front()   * age_group_proportion;
-            new_infections += sevirds.infectedD2.at(i).front()  * age_group_proportion;
-            new_recoveries += sevirds.recoveredD2.at(i).front() * age_group_proportion;
-        }
-    }
-
-    // Precision corrrection
-    new_exposed    = sevirds.precision_divider(new_exposed);
-    new_infections = sevirds.precision_divider(new_infections);
-    new_recoveries = sevirds.precision_divider(new_recoveries);
-
-    // Calculate the totals from each day in every phase
-    double total_susceptible = sevirds.precision_divider(sevirds.get_total_susceptible(true));
-    double total_exposed     = sevirds.precision_divider(sevirds.get_total_exposed());
-    double total_infected    = sevirds.precision_divider(sevirds.get_total_infections());
-    double total_recovered   = sevirds.precision_divider(sevirds.get_total_recovered());
-    double total_fatalities  = sevirds.precision_divider(sevirds.get_total_fatalities());
-
-    // Susceptible Vaccinated
-    double total_vaccinatedD1 = 0.0, total_vaccinatedD2 = 0.0;
-    if (sevirds.vaccines)
-    {
-        total_vaccinatedD1 = sevirds.precision_divider(sevirds.get_total_vaccinatedD1());
-        total_vaccinatedD2 = sevirds.precision_divider(sevirds.get_total_vaccinatedD2());
-    }
-
-    // Pipe all the data
-    os << "<" << sevirds.population << "," << total_susceptible << "," << total_exposed << "," << total_vaccinatedD1
-        << "," << total_vaccinatedD2 << "," << total_infected << "," << total_recovered << "," << new_exposed
-        << "," << new_infections << "," << new_recoveries << "," << total_fatalities << ">";
+    // Pipe all the data, formatted at once (see log_format.hpp)
+    log_format::write(os, sevirds.log_values());
     return os;
 }
 
 /**
  * @brief Reads the data from the json under the "default" parameter
- * 
+ *
  * @param json Contains the json file
  * @param current_sevirds Object to store the data
  */
 void from_json(const nlohmann::json& json, sevirds& current_sevirds)
 {
+    using proportionVector = sevirds::proportionVector;
+
+    // Read into nested vectors first, they're packed into the contiguous buffer once validated
+    vector<double> age_group_proportions;
+    vector<double> fatalities;
+    proportionVector susceptible, vaccinatedD1, vaccinatedD2;
+    proportionVector exposed, exposedD1, exposedD2;
+    proportionVector infected, infectedD1, infectedD2;
+    proportionVector recovered, recoveredD1, recoveredD2;
+    proportionVector immunityD1_rate, immunityD2_rate;
+
     json.at("population").get_to(current_sevirds.population);
-    json.at("age_group_proportions").get_to(current_sevirds.age_group_proportions);
+    json.at("age_group_proportions").get_to(age_group_proportions);
 
-    try { json.at("susceptible").get_to(current_sevirds.susceptible); }
+    try { json.at("susceptible").get_to(susceptible); }
     catch(nlohmann::detail::type_error &e) { AssertLong(false, __FILE__, __LINE__, "Error reading the susceptible vector from either default.json OR infectedCell.json\nVerify the format is [[#], [#], ...] and NOT [#, #, ...]"); }
 
-    json.at("vaccinatedD1").get_to(current_sevirds.vaccinatedD1);
-    json.at("vaccinatedD2").get_to(current_sevirds.vaccinatedD2);
+    json.at("vaccinatedD1").get_to(vaccinatedD1);
+    json.at("vaccinatedD2").get_to(vaccinatedD2);
 
-    json.at("exposed").get_to(current_sevirds.exposed);
-    json.at("exposedD1").get_to(current_sevirds.exposedD1);
-    json.at("exposedD2").get_to(current_sevirds.exposedD2);
+    json.at("exposed").get_to(exposed);
+    json.at("exposedD1").get_to(exposedD1);
+    json.at("exposedD2").get_to(exposedD2);
 
-    json.at("infected").get_to(current_sevirds.infected);
-    json.at("infectedD1").get_to(current_sevirds.infectedD1);
-    json.at("infectedD2").get_to(current_sevirds.infectedD2);
+    json.at("infected").get_to(infected);
+    json.at("infectedD1").get_to(infectedD1);
+    json.at("infectedD2").get_to(infectedD2);
 
-    json.at("recovered").get_to(current_sevirds.recovered);
-    json.at("recoveredD1").get_to(current_sevirds.recoveredD1);
-    json.at("recoveredD2").get_to(current_sevirds.recoveredD2);
+    json.at("recovered").get_to(recovered);
+    json.at("recoveredD1").get_to(recoveredD1);
+    json.at("recoveredD2").get_to(recoveredD2);
 
-    json.at("fatalities").get_to(current_sevirds.fatalities);
+    json.at("fatalities").get_to(fatalities);
 
     json.at("disobedient").get_to(current_sevirds.disobedient);
     json.at("hospital_capacity").get_to(current_sevirds.hospital_capacity);
     json.at("fatality_modifier").get_to(current_sevirds.fatality_modifier);
 
-    json.at("immunityD1").get_to(current_sevirds.immunityD1_rate);
-    json.at("immunityD2").get_to(current_sevirds.immunityD2_rate);
+    json.at("immunityD1").get_to(immunityD1_rate);
+    json.at("immunityD2").get_to(immunityD2_rate);
     json.at("min_interval_between_doses").get_to(current_sevirds.min_interval_doses);
     json.at("min_interval_between_recovery_and_vaccine").get_to(current_sevirds.min_interval_recovery_to_vaccine);
 
-    current_sevirds.num_age_groups = current_sevirds.age_group_proportions.size();
+    current_sevirds.num_age_groups = age_group_proportions.size();
     unsigned int age_groups        = current_sevirds.num_age_groups;
 
-    AssertLong(accumulate(current_sevirds.age_group_proportions.begin(), current_sevirds.age_group_proportions.end(), 0.0) == 1,
+    AssertLong(accumulate(age_group_proportions.begin(), age_group_proportions.end(), 0.0) == 1,
                 __FILE__, __LINE__,
                 "The age group proportions need to add up to 1");
 
     // Checks if the phases have the correct number of age groups
-    AssertLong(age_groups <= current_sevirds.susceptible.size() && age_groups <= current_sevirds.exposed.size() && age_groups <= current_sevirds.infected.size() &&
-                    age_groups <= current_sevirds.recovered.size() && age_groups <= current_sevirds.fatalities.size() && age_groups <= current_sevirds.vaccinatedD1.size() &&
-                    age_groups <= current_sevirds.vaccinatedD2.size() && age_groups <= current_sevirds.immunityD1_rate.size() && age_groups <= current_sevirds.immunityD2_rate.size() &&
-                    age_groups <= current_sevirds.exposedD1.size() && age_groups <= current_sevirds.infectedD2.size() && age_groups <= current_sevirds.recoveredD2.size() &&
-                    age_groups <= current_sevirds.exposedD2.size() && age_groups <= current_sevirds.infectedD2.size() && age_groups <= current_sevirds.recoveredD2.size(),
+    AssertLong(age_groups <= susceptible.size() && age_groups <= exposed.size() && age_groups <= infected.size() &&
+                    age_groups <= recovered.size() && age_groups <= fatalities.size() && age_groups <= vaccinatedD1.size() &&
+                    age_groups <= vaccinatedD2.size() && age_groups <= immunityD1_rate.size() && age_groups <= immunityD2_rate.size() &&
+                    age_groups <= exposedD1.size() && age_groups <= infectedD2.size() && age_groups <= recoveredD2.size() &&
+                    age_groups <= exposedD2.size() && age_groups <= infectedD2.size() && age_groups <= recoveredD2.size(),
                 __FILE__, __LINE__,
                 "There must be at least " + to_string(age_groups) + " age groups for each of the lists under the 'states' parameter in default.json as well as in infectedCell.json");
 
+    // One value per age group is stored as a single phase day
+    proportionVector proportions_rows, fatalities_rows;
     for (unsigned int a = 0; a < age_groups; ++a)
     {
-        double pop = current_sevirds.susceptible.at(a).front()
-                    + accumulate(current_sevirds.exposed.at(a).begin(),   current_sevirds.exposed.at(a).end(),   0.0)
-                    + accumulate(current_sevirds.infected.at(a).begin(),  current_sevirds.infected.at(a).end(),  0.0)
-                    + accumulate(current_sevirds.recovered.at(a).begin(), current_sevirds.recovered.at(a).end(), 0.0)
-                    + current_sevirds.fatalities.at(a)
-                    + accumulate(current_sevirds.vaccinatedD1.at(a).begin(), current_sevirds.vaccinatedD1.at(a).end(), 0.0)
-                    + accumulate(current_sevirds.vaccinatedD2.at(a).begin(), current_sevirds.vaccinatedD2.at(a).end(), 0.0)
-                    + accumulate(current_sevirds.exposedD1.at(a).begin(),    current_sevirds.exposedD1.at(a).end(),    0.0)
-                    + accumulate(current_sevirds.exposedD2.at(a).begin(),    current_sevirds.exposedD2.at(a).end(),    0.0)
-                    + accumulate(current_sevirds.infectedD1.at(a).begin(),   current_sevirds.infectedD1.at(a).end(),   0.0)
-                    + accumulate(current_sevirds.infectedD2.at(a).begin(),   current_sevirds.infectedD2.at(a).end(),   0.0)
-                    + accumulate(current_sevirds.recoveredD1.at(a).begin(),  current_sevirds.recoveredD1.at(a).end(),  0.0)
-                    + accumulate(current_sevirds.recoveredD2.at(a).begin(),  current_sevirds.recoveredD2.at(a).end(),  0.0);
+        proportions_rows.push_back({age_group_proportions.at(a)});
+        fatalities_rows.push_back({fatalities.at(a)});
+    }
+
+    current_sevirds.pack({ proportions_rows,
+                           susceptible, vaccinatedD1, vaccinatedD2,
+                           exposed,     exposedD1,    exposedD2,
+                           infected,    infectedD1,   infectedD2,
+                           recovered,   recoveredD1,  recoveredD2,
+                           fatalities_rows,
+                           immunityD1_rate, immunityD2_rate });
+
+    for (unsigned int a = 0; a < age_groups; ++a)
+    {
+        double pop = current_sevirds.susceptible(a).front()
+                    + sevirds::sum_state_vector(current_sevirds.exposed(a))
+                    + sevirds::sum_state_vector(current_sevirds.infected(a))
+                    + sevirds::sum_state_vector(current_sevirds.recovered(a))
+                    + current_sevirds.fatalities(a)
+                    + sevirds::sum_state_vector(current_sevirds.vaccinatedD1(a))
+                    + sevirds::sum_state_vector(current_sevirds.vaccinatedD2(a))
+                    + sevirds::sum_state_vector(current_sevirds.exposedD1(a))
+                    + sevirds::sum_state_vector(current_sevirds.exposedD2(a))
+                    + sevirds::sum_state_vector(current_sevirds.infectedD1(a))
+                    + sevirds::sum_state_vector(current_sevirds.infectedD2(a))
+                    + sevirds::sum_state_vector(current_sevirds.recoveredD1(a))
+                    + sevirds::sum_state_vector(current_sevirds.recoveredD2(a));
 
         AssertLong(pop == 1.0, __FILE__, __LINE__, "The vectors don't add up to 1! " + to_string(pop) + " Double check the values in default.json AND infectedCell.json");
     }
@@ -519,9 +733,45 @@ void from_json(const nlohmann::json& json, sevirds& current_sevirds)
     }
 
     // Recovered Dose 1 can't be smaller then Susceptible Vaccinated Dose 1
-    AssertLong(current_sevirds.recoveredD1.front().size() >= current_sevirds.vaccinatedD1.front().size(),
+    AssertLong(current_sevirds.layout[sevirds::RECOVERED_D1].phases >= current_sevirds.get_num_vaccinated1_phases(),
                 __FILE__, __LINE__,
                 "The recovery phase for those vaccinated with their first dose needs to be smaller then vaccinatedD1!");
 }
 
-#endif //PANDEMIC_HOYA_2002_SEIRD_HPP
\ No newline at end of file
+/**
+ * The state Cadmium keeps for a cell and sends to its neighbors. Only the public part is
+ * copied into each message and each neighbor's neighbors_state; the whole state is shared
+ * with the cell that computed it and is only read to log it.
+*/
+struct sevirds_message : sevirds_public
+{
+    shared_ptr<sevirds const> full; // Null in the placeholders Cadmium starts a neighborhood with
+
+    sevirds_message() = default;
+
+    explicit sevirds_message(sevirds_public const& published) : sevirds_public(published) { }
+
+    explicit sevirds_message(shared_ptr<sevirds const> state) : sevirds_public(*state), full(move(state)) { }
+
+    bool operator!=(sevirds_message const& other) const
+    {
+        if (full == other.full)
+            return false;
+        return !full || !other.full || *full != *other.full;
+    }
+};
+
+// Logs the whole state, exactly like the sevirds it carries
+ostream& operator<<(ostream& os, sevirds_message const& message)
+{
+    if (message.full)
+        os << *message.full;
+    return os;
+}
+
+void from_json(nlohmann::json const& json, sevirds_message& message)
+{
+    message = sevirds_message(make_shared<sevirds const>(json.get<sevirds>()));
+}
+
+#endif //PANDEMIC_HOYA_2002_SEIRD_HPP
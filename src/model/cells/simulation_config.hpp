@@ -7,6 +7,8 @@
 #include <nlohmann/json.hpp>
 #include "../Helpers/Assert.hpp"
 
+using namespace Assert;
+
 struct simulation_config
 {
     int prec_divider;
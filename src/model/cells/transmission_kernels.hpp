@@ -0,0 +1,171 @@
+#ifndef PANDEMIC_HOYA_2002_TRANSMISSION_KERNELS_HPP
+#define PANDEMIC_HOYA_2002_TRANSMISSION_KERNELS_HPP
+
+#include <new>
+#include <cstddef>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define PANDEMIC_X86_KERNELS 1
+    #include <immintrin.h>
+#else
+    #define PANDEMIC_X86_KERNELS 0
+#endif
+
+using namespace std;
+
+/**
+ * Dot products of the fused μ(n) * λ(n) weights of an age group (see rate_tables::transmission_weights())
+ * with the infected phase days of a state. The kernel is picked once from what the CPU supports.
+ *
+ * Every kernel keeps four running sums, element i going to sum i % 4, adds them as
+ * (s0 + s1) + (s2 + s3) and then adds the leftover elements in order. The sums are the
+ * same whichever kernel runs, so the results don't depend on the machine. They aren't the
+ * same as adding the elements one after the other, as the model did before the kernels: a
+ * sum can differ from that in its last bits, which the logs' 6 significant digits hide.
+*/
+namespace transmission_kernels
+{
+    // Doubles in a vector register of the widest kernel, the weights are padded to a multiple of it
+    constexpr unsigned int WIDTH = 4;
+
+    // Alignment of the weights, one AVX register
+    constexpr size_t ALIGNMENT = WIDTH * sizeof(double);
+
+    /**
+     * @brief Allocates with ALIGNMENT so the weights can be loaded with aligned loads
+    */
+    template <typename V>
+    struct aligned_allocator
+    {
+        using value_type = V;
+
+        aligned_allocator() = default;
+        template <typename U>
+        aligned_allocator(aligned_allocator<U> const&) { }
+
+        V* allocate(size_t n)             { return static_cast<V*>(::operator new(n * sizeof(V), align_val_t(ALIGNMENT))); }
+        void deallocate(V* data, size_t) { ::operator delete(data, align_val_t(ALIGNMENT));                             }
+
+        template <typename U>
+        bool operator==(aligned_allocator<U> const&) const { return true; }
+        template <typename U>
+        bool operator!=(aligned_allocator<U> const&) const { return false; }
+    };
+
+    /**
+     * @brief sum(weights[i] * values[i])
+     *
+     * @param weights Aligned to ALIGNMENT
+     * @param values Any alignment
+     * @param size Number of elements
+     * @return double
+    */
+    using kernel = double (*)(double const* weights, double const* values, unsigned int size);
+
+    inline double dot_scalar(double const* weights, double const* values, unsigned int size)
+    {
+        double sums[WIDTH] = {0, 0, 0, 0};
+
+        unsigned int i = 0;
+        for (; i + WIDTH <= size; i += WIDTH)
+        {
+            for (unsigned int lane = 0; lane < WIDTH; ++lane)
+                sums[lane] += weights[i + lane] * values[i + lane];
+        }
+
+        double total = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+        for (; i < size; ++i)
+            total += weights[i] * values[i];
+
+        return total;
+    }
+
+#if PANDEMIC_X86_KERNELS
+    __attribute__((target("sse2")))
+    inline double dot_sse2(double const* weights, double const* values, unsigned int size)
+    {
+        __m128d sums01 = _mm_setzero_pd();
+        __m128d sums23 = _mm_setzero_pd();
+
+        unsigned int i = 0;
+        for (; i + WIDTH <= size; i += WIDTH)
+        {
+            sums01 = _mm_add_pd(sums01, _mm_mul_pd(_mm_load_pd(weights + i),     _mm_loadu_pd(values + i)));
+            sums23 = _mm_add_pd(sums23, _mm_mul_pd(_mm_load_pd(weights + i + 2), _mm_loadu_pd(values + i + 2)));
+        }
+
+        double total = _mm_cvtsd_f64(_mm_add_sd(sums01, _mm_unpackhi_pd(sums01, sums01)))
+                     + _mm_cvtsd_f64(_mm_add_sd(sums23, _mm_unpackhi_pd(sums23, sums23)));
+        for (; i < size; ++i)
+            total += weights[i] * values[i];
+
+        return total;
+    }
+
+    __attribute__((target("avx2")))
+    inline double dot_avx2(double const* weights, double const* values, unsigned int size)
+    {
+        __m256d sums = _mm256_setzero_pd();
+
+        unsigned int i = 0;
+        for (; i + WIDTH <= size; i += WIDTH)
+            sums = _mm256_add_pd(sums, _mm256_mul_pd(_mm256_load_pd(weights + i), _mm256_loadu_pd(values + i)));
+
+        __m128d sums01 = _mm256_castpd256_pd128(sums);
+        __m128d sums23 = _mm256_extractf128_pd(sums, 1);
+        double total = _mm_cvtsd_f64(_mm_add_sd(sums01, _mm_unpackhi_pd(sums01, sums01)))
+                     + _mm_cvtsd_f64(_mm_add_sd(sums23, _mm_unpackhi_pd(sums23, sums23)));
+        for (; i < size; ++i)
+            total += weights[i] * values[i];
+
+        return total;
+    }
+#endif
+
+    /**
+     * @brief The widest kernel the CPU supports
+     *
+     * @param name Set to the name of the kernel when not null
+     * @return kernel
+    */
+    inline kernel best(string* name = nullptr)
+    {
+        kernel chosen = dot_scalar;
+        string chosen_name = "scalar";
+
+#if PANDEMIC_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            chosen = dot_avx2;
+            chosen_name = "avx2";
+        }
+        else if (__builtin_cpu_supports("sse2"))
+        {
+            chosen = dot_sse2;
+            chosen_name = "sse2";
+        }
+#endif
+
+        if (name != nullptr)
+            *name = chosen_name;
+        return chosen;
+    }
+
+    /**
+     * @brief sum(weights[i] * values[i]) with the best kernel
+     *
+     * @param weights Aligned to ALIGNMENT
+     * @param values Any alignment
+     * @param size Number of elements
+     * @return double
+    */
+    inline double dot(double const* weights, double const* values, unsigned int size)
+    {
+        static kernel const chosen = best();
+        return chosen(weights, values, size);
+    }
+} //namespace transmission_kernels
+
+#endif //PANDEMIC_HOYA_2002_TRANSMISSION_KERNELS_HPP
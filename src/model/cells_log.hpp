@@ -0,0 +1,359 @@
+#ifndef PANDEMIC_HOYA_2002_CELLS_LOG_HPP
+#define PANDEMIC_HOYA_2002_CELLS_LOG_HPP
+
+#include <array>
+#include <cmath>
+#include <algorithm>
+#include <tuple>
+#include <memory>
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <unordered_map>
+#include <boost/type_index.hpp>
+#include "cells/geographical_cell.hpp"
+
+using namespace std;
+
+/**
+ * Where the engines that step the cells themselves (see lockstep_runner.hpp and region_set.hpp)
+ * write what happens each day. Cadmium's own runner logs through its loggers instead (see log_modes.hpp).
+ *
+ * A day is given to a log in two calls: log() with the states the cells are in on the day, then
+ * transitions() once they've all moved to the next one. Cadmium only runs the transition of a cell
+ * when the cell or one of its neighbors changed, and only logs the cells whose transition ran, so
+ * both calls say which cells did. The flags are indexed by the cells' cell_index.
+*/
+template <typename T>
+class cells_log
+{
+    public:
+        virtual ~cells_log() = default;
+
+        /**
+         * @brief Logs the states the cells are in on a day
+         *
+         * @param time Day
+         * @param cells In the order they were added, which is the log order
+         * @param changed Whether each cell's state changed into the day's. Every cell sends its
+         * first state, so they all changed into the first day
+        */
+        virtual void log(T time, vector<geographical_cell<T>*> const& cells, vector<unsigned char> const& changed) = 0;
+
+        /**
+         * @brief Logs the states the cells moved to at the end of a day
+         *
+         * @param time Day that was computed
+         * @param cells In the log order
+         * @param transitioned Whether Cadmium would have run each cell's transition on the day,
+         * i.e. the cell or one of its neighbors changed into the day's state
+        */
+        virtual void transitions(T time, vector<geographical_cell<T>*> const& cells, vector<unsigned char> const& transitioned) { }
+
+        virtual void flush() = 0;
+};
+
+/**
+ * The states in the same format and order as Cadmium's global time and state loggers write them.
+ * Every cell is logged when the simulation starts, then each day has the cells whose transition
+ * ran, with the state they moved to. Nothing is logged for a day on which no cell changed, as
+ * Cadmium's runner stops once no cell has a new state to send.
+*/
+template <typename T>
+class state_log : public cells_log<T>
+{
+    private:
+        ostream& out;
+        string const coupled_id;
+        bool started = false;
+
+        // Cadmium names a cell's model after the coupled model it's in (see geographical_coupled::cell_model_id())
+        void write(geographical_cell<T> const& cell)
+        {
+            out << "State for model " << coupled_id << '_' << cell.cell_id << " is " << cell.buffered_state() << '\n';
+        }
+
+    public:
+        /**
+         * @param out State log
+         * @param coupled_id Id of the coupled model of the cells, empty in main.cpp
+        */
+        explicit state_log(ostream& out, string coupled_id = "") : out(out), coupled_id(move(coupled_id)) { }
+
+        void log(T time, vector<geographical_cell<T>*> const& cells, vector<unsigned char> const& changed) override
+        {
+            if (started)
+                return;
+
+            out << time << '\n';
+            for (geographical_cell<T> const* cell : cells)
+                write(*cell);
+            started = true;
+        }
+
+        void transitions(T time, vector<geographical_cell<T>*> const& cells, vector<unsigned char> const& transitioned) override
+        {
+            bool any = false;
+            for (geographical_cell<T> const* cell : cells)
+            {
+                if (!transitioned[cell->cell_index])
+                    continue;
+
+                if (!any)
+                    out << time << '\n';
+                any = true;
+                write(*cell);
+            }
+        }
+
+        void flush() override { out.flush(); }
+};
+
+/**
+ * The messages the cells send, in the same format and order as Cadmium's global time and message
+ * loggers write them: a cell sends its state on the days it changed into it, every cell sends its
+ * first state. The port and the message are those of Cadmium's cells, which write themselves.
+*/
+template <typename T>
+class message_log : public cells_log<T>
+{
+    private:
+        using cell_out     = typename tuple_element<0, typename geographical_cell<T>::output_ports>::type;
+        using message_type = typename cell_out::message_type;
+
+        ostream& out;
+        string const coupled_id;
+        string const port; // As Cadmium's message logger names it
+        bool started = false;
+
+    public:
+        /**
+         * @param out Message log
+         * @param coupled_id Id of the coupled model of the cells, empty in main.cpp
+        */
+        explicit message_log(ostream& out, string coupled_id = "") :
+            out(out), coupled_id(move(coupled_id)), port(boost::typeindex::type_id<cell_out>().pretty_name()) { }
+
+        void log(T time, vector<geographical_cell<T>*> const& cells, vector<unsigned char> const& changed) override
+        {
+            // Cadmium logs the time it starts at, then the time of the first messages
+            if (!started)
+                out << time << '\n';
+            started = true;
+
+            bool any = false;
+            for (geographical_cell<T> const* cell : cells)
+            {
+                if (!changed[cell->cell_index])
+                    continue;
+
+                if (!any)
+                    out << time << '\n';
+                any = true;
+
+                out << '[' << port << ": {" << message_type{cell->cell_id, cell->state.current_state} << "}] generated by model "
+                    << coupled_id << '_' << cell->cell_id << '\n';
+            }
+        }
+
+        void flush() override { out.flush(); }
+};
+
+/**
+ * Several logs written together, e.g. the state and message logs of -log=all
+*/
+template <typename T>
+class multi_log : public cells_log<T>
+{
+    private:
+        vector<shared_ptr<cells_log<T>>> logs;
+
+    public:
+        explicit multi_log(vector<shared_ptr<cells_log<T>>> logs) : logs(move(logs)) { }
+
+        void log(T time, vector<geographical_cell<T>*> const& cells, vector<unsigned char> const& changed) override
+        {
+            for (shared_ptr<cells_log<T>> const& l : logs)
+                l->log(time, cells, changed);
+        }
+
+        void transitions(T time, vector<geographical_cell<T>*> const& cells, vector<unsigned char> const& transitioned) override
+        {
+            for (shared_ptr<cells_log<T>> const& l : logs)
+                l->transitions(time, cells, transitioned);
+        }
+
+        void flush() override
+        {
+            for (shared_ptr<cells_log<T>> const& l : logs)
+                l->flush();
+        }
+};
+
+/**
+ * The state log with only the lines of the cells whose values changed since they were last
+ * logged (-log=changes). Most cells far from an outbreak stay the same for weeks. The first
+ * time has every cell, then each time of the state log (see state_log) has the lines that
+ * changed, so the log reads as a state log in which a cell keeps its last line. A line's
+ * fingerprint (see sevirds::fingerprint()) is compared instead of its values, and only for the
+ * cells whose transition ran; a change beyond the logged digits only repeats a line.
+ *
+ * expand_changes() writes the whole line of every cell for each time again.
+*/
+template <typename T>
+class change_log : public cells_log<T>
+{
+    private:
+        ostream& out;
+        vector<uint64_t> last; // Fingerprint of each cell the last time it was logged, by cell_index
+
+        void write(geographical_cell<T> const& cell)
+        {
+            out << "State for model _" << cell.cell_id << " is " << cell.buffered_state() << '\n';
+        }
+
+    public:
+        explicit change_log(ostream& out) : out(out) { }
+
+        void log(T time, vector<geographical_cell<T>*> const& cells, vector<unsigned char> const& changed) override
+        {
+            if (!last.empty())
+                return;
+
+            last.resize(changed.size());
+            out << time << '\n';
+            for (geographical_cell<T> const* cell : cells)
+            {
+                last[cell->cell_index] = sevirds::fingerprint(cell->buffered_state().log_values());
+                write(*cell);
+            }
+        }
+
+        void transitions(T time, vector<geographical_cell<T>*> const& cells, vector<unsigned char> const& transitioned) override
+        {
+            // Like the state log, a day on which no cell transitioned has no time
+            if (find(transitioned.begin(), transitioned.end(), 1) == transitioned.end())
+                return;
+
+            out << time << '\n';
+            for (geographical_cell<T> const* cell : cells)
+            {
+                if (!transitioned[cell->cell_index])
+                    continue;
+
+                uint64_t const fingerprint = sevirds::fingerprint(cell->buffered_state().log_values());
+                if (fingerprint == last[cell->cell_index])
+                    continue;
+
+                last[cell->cell_index] = fingerprint;
+                write(*cell);
+            }
+        }
+
+        void flush() override { out.flush(); }
+};
+
+/**
+ * @brief Writes a log of change_log, or a state log, as a state log with every cell at every
+ * time: a cell missing from a time keeps its last line, in the order of the first time
+ *
+ * @param in Log of change_log or state log
+ * @param out State log
+ * @return uint64_t Number of times written
+*/
+uint64_t expand_changes(istream& in, ostream& out)
+{
+    static string const PREFIX = "State for model ";
+
+    vector<string> lines;                     // Last line of each cell, in log order
+    unordered_map<string, unsigned int> cell; // Cell's part of a line -> its index in lines
+    string time, line;
+    uint64_t days = 0;
+
+    auto write_day = [&]()
+    {
+        out << time << '\n';
+        for (string const& l : lines)
+            out << l << '\n';
+        ++days;
+    };
+
+    while (getline(in, line))
+    {
+        if (line.compare(0, PREFIX.size(), PREFIX) != 0)
+        {
+            if (!time.empty())
+                write_day();
+            time = line;
+            continue;
+        }
+
+        string id = line.substr(0, line.find(" is "));
+        auto found = cell.find(id);
+        if (found == cell.end())
+        {
+            cell.emplace(move(id), lines.size());
+            lines.push_back(line);
+        }
+        else
+            lines[found->second] = line;
+    }
+
+    if (!time.empty())
+        write_day();
+
+    return days;
+}
+
+/**
+ * One line per day with the number of people in each compartment over every cell, counted
+ * the way Scripts/Graph_Generator/graph_aggregates.py counts them from the state log:
+ * each cell's share is rounded to whole people before they're added up. The script reads the
+ * values with the digits the log keeps, so its counts can be a few people off these.
+ *
+ * The script merges the blocks of a time, so its day t holds the states the cells moved to on
+ * day t. A row is written once the day's transitions are done, for each time the state log has.
+*/
+template <typename T>
+class aggregate_log : public cells_log<T>
+{
+    private:
+        ostream& out;
+
+    public:
+        explicit aggregate_log(ostream& out) : out(out)
+        {
+            // The columns of the state log
+            out << "time,population,S,E,VD1,VD2,I,R,new_E,new_I,new_R,D\n";
+        }
+
+        void log(T time, vector<geographical_cell<T>*> const& cells, vector<unsigned char> const& changed) override { }
+
+        void transitions(T time, vector<geographical_cell<T>*> const& cells, vector<unsigned char> const& transitioned) override
+        {
+            if (find(transitioned.begin(), transitioned.end(), 1) == transitioned.end())
+                return;
+
+            // The population, then the people in each compartment
+            array<double, sevirds::NUM_LOG_VALUES> people{};
+
+            for (geographical_cell<T> const* cell : cells)
+            {
+                array<double, sevirds::NUM_LOG_VALUES> const values = cell->buffered_state().log_values();
+
+                people[0] += values[0];
+                for (unsigned int c = 1; c < values.size(); ++c)
+                    people[c] += round(values[0] * values[c]);
+            }
+
+            out << time;
+            for (double count : people)
+                out << ',' << (long long)count;
+            out << '\n';
+        }
+
+        void flush() override { out.flush(); }
+};
+
+#endif //PANDEMIC_HOYA_2002_CELLS_LOG_HPP
@@ -4,33 +4,632 @@
 #ifndef PANDEMIC_HOYA_2002_ZHONG_COUPLED_HPP
 #define PANDEMIC_HOYA_2002_ZHONG_COUPLED_HPP
 
+#include <deque>
+#include <fstream>
+#include <algorithm>
 #include <nlohmann/json.hpp>
 #include <cadmium/celldevs/coupled/cells_coupled.hpp>
+#include <cadmium/modeling/dynamic_model_translator.hpp>
 #include "cells/geographical_cell.hpp"
+#include "region_set.hpp"
+#include "scenario_reader.hpp"
+#include "scenario_image.hpp"
 
 using namespace std;
 
 template <typename T>
-class geographical_coupled : public cadmium::celldevs::cells_coupled<T, string, sevirds, vicinity>
+class geographical_coupled : public cadmium::celldevs::cells_coupled<T, string, sevirds_message, vicinity>
 {
     public:
-        explicit geographical_coupled(string const &id) : cells_coupled<T, string, sevirds, vicinity>(id) { }
+        explicit geographical_coupled(string const &id) : cells_coupled<T, string, sevirds_message, vicinity>(id) { }
 
         template<typename X>
         using cell_unordered = unordered_map<string, X>;
 
+        // Shared by every cell, see neighborhood_graph.hpp
+        shared_ptr<neighborhood_graph> graph = make_shared<neighborhood_graph>();
+
+        // Set before the cells are added to keep them out of Cadmium, they're stepped by lockstep_runner instead
+        bool detached = false;
+        vector<shared_ptr<geographical_cell<T>>> detached_cells; // In the order they're added
+
+        // Set before the cells are added to keep them out of Cadmium, they're all stepped by a single
+        // atomic model instead (see region_set.hpp) which uses this many threads
+        bool as_region_set = false;
+        unsigned int region_set_threads = 1;
+        shared_ptr<cells_log<T>> region_set_log; // Optional, see region_set.hpp
+
+        // Set before the cells are added to have Cadmium's transitions computed ahead on a pool of threads
+        shared_ptr<parallel_transitions<T>> transitions;
+
+        // One copy of each distinct set of rates, see rate_tables.hpp
+        rate_tables_registry rates_registry;
+
+        // A config block that has been read, its rates are in the shared tables
+        struct parsed_config
+        {
+            nlohmann::json json;
+            simulation_config config;
+            shared_ptr<rate_tables const> rates;
+        };
+
+        // Hash of the JSON -> configs with that hash (more than one only on a collision).
+        // A deque so the configs don't move while cells read from the scenario point to them
+        unordered_map<size_t, deque<parsed_config>> config_cache;
+
+        // A cell read from the scenario, waiting to be added
+        struct scenario_cell
+        {
+            string id;
+            string type;
+            string delay_id;
+            sevirds initial_state;
+            vector<pair<string, vicinity>> neighborhood; // In scenario order, it decides the order of the edges
+            bool default_neighborhood;                   // Not given by the cell, see resolve_neighborhoods()
+            parsed_config const* parsed;
+        };
+
+        // The default cell of a scenario and what's been parsed from it so far
+        struct default_cell
+        {
+            nlohmann::json json = nlohmann::json::object();
+            parsed_config const* config = nullptr;
+            unique_ptr<sevirds> state;
+        };
+
+        /**
+         * @brief Reads a config block. Nearly every cell uses the default config so each
+         * distinct block is only parsed and validated the first time it's seen
+         *
+         * @param config JSON under the "config" parameter of a cell
+         * @return parsed_config const& Valid until the next call
+        */
+        parsed_config const& parse_config(nlohmann::json const& config)
+        {
+            deque<parsed_config>& bucket = config_cache[hash<nlohmann::json>{}(config)];
+            for (parsed_config const& parsed : bucket)
+            {
+                if (parsed.json == config)
+                    return parsed;
+            }
+
+            auto conf = config.get<typename geographical_cell<T>::config_type>();
+
+            // Cells with the same rates share them. This leaves the rates of conf empty
+            shared_ptr<rate_tables const> rates = rates_registry.intern(rate_tables(conf));
+
+            bucket.push_back({config, move(conf), move(rates)});
+            return bucket.back();
+        }
+
         void add_cell_json(string const& cell_type, string const& cell_id,
                             cell_unordered<vicinity> const& neighborhood,
-                            sevirds initial_state,
+                            sevirds_message initial_state,
                             string const& delay_id,
                             nlohmann::json const& config) override
+        {
+            add_parsed_cell(cell_type, cell_id, neighborhood, *initial_state.full, delay_id, parse_config(config));
+        }
+
+        void add_parsed_cell(string const& cell_type, string const& cell_id,
+                             cell_unordered<vicinity> const& neighborhood,
+                             sevirds initial_state,
+                             string const& delay_id,
+                             parsed_config const& parsed)
         {
             if (cell_type == "zhong")
             {
-                auto conf = config.get<typename geographical_cell<T>::config_type>();
-                this->template add_cell<geographical_cell>(cell_id, neighborhood, initial_state, delay_id, conf);
+                // The initial state is what the neighbors receive first so it has to be published here
+                initial_state.vaccines = parsed.config.is_vaccination;
+                geographical_cell<T>::publish(initial_state, *parsed.rates);
+
+                graph->add_cell(cell_id, neighborhood);
+                if (detached || as_region_set)
+                    detached_cells.push_back(make_shared<geographical_cell<T>>(cell_id, neighborhood, initial_state, delay_id, parsed.config,
+                                                                               parsed.rates, shared_ptr<neighborhood_graph const>(graph)));
+                else
+                    this->template add_cell<geographical_cell>(cell_id, neighborhood, initial_state, delay_id, parsed.config,
+                                                               parsed.rates, shared_ptr<neighborhood_graph const>(graph), transitions);
             } else throw bad_typeid();
         }
+
+        /**
+         * @brief Loads the cells of a scenario. Unlike the Cadmium version this never holds
+         * the whole document in memory (see read_cells_json())
+         *
+         * @param file_in Path to the scenario
+        */
+        void add_cells_json(string const& file_in)
+        {
+            for (scenario_cell& cell : read_cells_json(file_in))
+            {
+                add_scenario_cell(cell);
+                cell = scenario_cell(); // Frees the state and neighborhood now that the cell has its own
+            }
+        }
+
+        /**
+         * @brief Reads every cell of a scenario. Each cell is read on its own through scenario_reader,
+         * turned into its state, neighborhood and config and its JSON is thrown away.
+         *
+         * A scenario can also be written compactly: the cells only give what differs from the
+         * default cell (usually just the population) and their neighborhoods are listed under
+         * "edges" (see resolve_neighborhoods())
+         *
+         * @param file_in Path to the scenario
+         * @return vector<scenario_cell> In the order of their IDs, the same order Cadmium adds them in
+        */
+        vector<scenario_cell> read_cells_json(string const& file_in)
+        {
+            ifstream file(file_in);
+            if (!file.is_open())
+                throw runtime_error{"Unable to open the file: " + file_in};
+
+            default_cell defaults;
+            bool has_defaults = false;
+
+            vector<scenario_cell> cells;
+            vector<pair<string, nlohmann::json>> before_defaults; // Only when "default" isn't the first cell
+            vector<nlohmann::json> edges;
+
+            auto on_cell = [&](string const& cell_id, nlohmann::json&& cell)
+            {
+                if (cell_id == "default")
+                {
+                    defaults.json = move(cell);
+                    has_defaults  = true;
+                    for (pair<string, nlohmann::json>& early : before_defaults)
+                        cells.push_back(read_cell(early.first, early.second, defaults));
+                    before_defaults.clear();
+                }
+                else if (!has_defaults)
+                    before_defaults.emplace_back(cell_id, move(cell));
+                else
+                    cells.push_back(read_cell(cell_id, cell, defaults));
+            };
+            auto on_edge = [&](string const&, nlohmann::json&& edge) { edges.push_back(move(edge)); };
+
+            scenario_reader reader({{"cells", on_cell}, {"edges", on_edge}});
+            nlohmann::json::sax_parse(file, &reader);
+
+            // No default block at all
+            for (pair<string, nlohmann::json>& early : before_defaults)
+                cells.push_back(read_cell(early.first, early.second, defaults));
+
+            sort(cells.begin(), cells.end(), [](scenario_cell const& a, scenario_cell const& b) { return a.id < b.id; });
+            resolve_neighborhoods(cells, edges, defaults.json);
+            return cells;
+        }
+
+        /**
+         * @brief Gives a neighborhood to the cells that don't have one of their own.
+         * Without edges they get the one of the default cell. Otherwise each edge is
+         * [cell, neighbor, correlation] or [cell, neighbor, correlation, {vicinity fields}]
+         * and starts from the one vicinity in the default cell's neighborhood. A cell
+         * without an edge to itself gets one with the default vicinity.
+         *
+         * @param cells Cells of the scenario, sorted by ID
+         * @param edges Entries under "edges"
+         * @param defaults JSON of the default cell
+        */
+        static void resolve_neighborhoods(vector<scenario_cell>& cells, vector<nlohmann::json> const& edges,
+                                          nlohmann::json const& defaults)
+        {
+            nlohmann::json default_neighborhood = defaults.value("neighborhood", nlohmann::json::object());
+
+            if (edges.empty())
+            {
+                vector<pair<string, vicinity>> neighborhood;
+                for (auto& neighbor : default_neighborhood.items())
+                    neighborhood.emplace_back(neighbor.key(), neighbor.value().template get<vicinity>());
+
+                for (scenario_cell& cell : cells)
+                {
+                    if (cell.default_neighborhood)
+                        cell.neighborhood = neighborhood;
+                }
+                return;
+            }
+
+            if (default_neighborhood.size() != 1)
+                throw runtime_error{"The default cell's neighborhood must hold the one vicinity every edge starts from"};
+            nlohmann::json const& base_json = default_neighborhood.begin().value();
+            vicinity base = base_json.template get<vicinity>();
+
+            unordered_map<string, scenario_cell*> by_id;
+            for (scenario_cell& cell : cells)
+                by_id.insert({cell.id, &cell});
+
+            // Ordered by neighbor like the keys of a JSON neighborhood, so the edges end up in the same order
+            unordered_map<string, map<string, vicinity>> neighborhoods;
+
+            for (nlohmann::json const& edge : edges)
+            {
+                if (!edge.is_array() || edge.size() < 3 || edge.size() > 4)
+                    throw runtime_error{"An edge must be [cell, neighbor, correlation] optionally followed by the fields of its vicinity: " + edge.dump()};
+
+                auto from = by_id.find(edge[0].template get<string>());
+                if (from == by_id.end())
+                    throw runtime_error{"The edge " + edge.dump() + " doesn't start from a cell in the scenario"};
+                if (!from->second->default_neighborhood)
+                    continue; // The cell gave its own neighborhood
+
+                vicinity v;
+                if (edge.size() == 4)
+                {
+                    nlohmann::json patched = base_json;
+                    patched.merge_patch(edge[3]);
+                    v = patched.template get<vicinity>();
+                }
+                else
+                    v = base;
+                v.correlation = edge[2].template get<double>();
+
+                neighborhoods[from->first][edge[1].template get<string>()] = move(v);
+            }
+
+            for (scenario_cell& cell : cells)
+            {
+                if (!cell.default_neighborhood)
+                    continue;
+
+                map<string, vicinity>& neighborhood = neighborhoods[cell.id];
+                neighborhood.insert({cell.id, base}); // Only if there's no edge to itself
+
+                for (auto& neighbor : neighborhood)
+                    cell.neighborhood.emplace_back(neighbor.first, move(neighbor.second));
+                neighborhoods.erase(cell.id);
+            }
+        }
+
+        void add_scenario_cell(scenario_cell& cell)
+        {
+            // Inserted in scenario order so the map iterates the same way it did for the JSON loader
+            cell_unordered<vicinity> neighborhood;
+            for (pair<string, vicinity>& neighbor : cell.neighborhood)
+                neighborhood[neighbor.first] = move(neighbor.second);
+
+            add_parsed_cell(cell.type, cell.id, neighborhood, move(cell.initial_state), cell.delay_id, *cell.parsed);
+        }
+
+        /**
+         * @brief Reads a JSON scenario and saves it as an image (see scenario_image.hpp)
+         * that add_cells_image() can load without parsing or validating anything
+         *
+         * @param file_in Path to the JSON scenario
+         * @param file_out Path of the image
+         * @return unsigned int Number of cells
+        */
+        unsigned int compile_scenario(string const& file_in, string const& file_out)
+        {
+            using namespace scenario_image;
+
+            vector<scenario_cell> cells = read_cells_json(file_in);
+            writer image;
+
+            unordered_map<string, uint32_t> strings;
+            auto add_string = [&](string const& value) -> uint32_t
+            {
+                auto it = strings.find(value);
+                if (it != strings.end())
+                    return it->second;
+
+                image.push(STRING_OFFSETS, image.count<char>(STRINGS));
+                image.push(STRINGS, value.data(), value.size());
+
+                uint32_t id = strings.size();
+                strings.insert({value, id});
+                return id;
+            };
+
+            unordered_map<string, uint32_t> dense_ids;
+            for (scenario_cell const& cell : cells)
+                dense_ids.insert({cell.id, (uint32_t)dense_ids.size()});
+
+            unordered_map<parsed_config const*, uint32_t> configs;
+            for (scenario_cell const& cell : cells)
+            {
+                auto config = configs.find(cell.parsed);
+                if (config == configs.end())
+                {
+                    config = configs.insert({cell.parsed, (uint32_t)configs.size()}).first;
+                    write_config(image, *cell.parsed);
+                }
+
+                image.push(CELLS, cell_record{add_string(cell.id), add_string(cell.type), add_string(cell.delay_id), config->second});
+
+                sevirds const& state = cell.initial_state;
+                state_record record{state.population, state.disobedient, state.hospital_capacity, state.fatality_modifier,
+                                    state.min_interval_doses, state.min_interval_recovery_to_vaccine, state.num_age_groups,
+                                    image.count<double>(STATE_VALUES), {}};
+                for (unsigned int c = 0; c < sevirds::NUM_COMPARTMENTS; ++c)
+                    record.phases[c] = state.layout[c].phases;
+                image.push(STATES, record);
+                image.push(STATE_VALUES, state.buffer.data(), state.buffer.size());
+
+                image.push(ROW_OFFSETS, image.count<uint32_t>(NEIGHBORS));
+                for (pair<string, vicinity> const& neighbor : cell.neighborhood)
+                {
+                    auto j = dense_ids.find(neighbor.first);
+                    if (j == dense_ids.end())
+                        throw runtime_error{"The neighbor " + neighbor.first + " is not a cell in the scenario"};
+
+                    image.push(NEIGHBORS, j->second);
+                    image.push(CORRELATIONS, neighbor.second.correlation);
+                    image.push(FACTOR_OFFSETS, image.count<factor_record>(FACTORS));
+                    for (auto const& factor : neighbor.second.correction_factors)
+                        image.push(FACTORS, factor_record{factor.first, factor.second[0], factor.second[1]});
+                }
+            }
+
+            // Closing offsets
+            image.push(STRING_OFFSETS, image.count<char>(STRINGS));
+            image.push(ROW_OFFSETS, image.count<uint32_t>(NEIGHBORS));
+            image.push(FACTOR_OFFSETS, image.count<factor_record>(FACTORS));
+            image.push(TABLES, image.count<uint32_t>(ROWS));
+            image.push(ROWS, image.count<double>(RATES));
+
+            image.save(file_out);
+            return cells.size();
+        }
+
+        static void write_config(scenario_image::writer& image, parsed_config const& parsed)
+        {
+            using namespace scenario_image;
+
+            config_record record{parsed.config.prec_divider, parsed.config.reSusceptibility, parsed.config.is_vaccination,
+                                 {}, image.count<uint32_t>(TABLES)};
+            image.push(CONFIGS, record);
+
+            for (rate_tables::phase_rates const* table : parsed.rates->tables())
+            {
+                image.push(TABLES, image.count<uint32_t>(ROWS));
+                for (vector<double> const& row : *table)
+                {
+                    image.push(ROWS, image.count<double>(RATES));
+                    image.push(RATES, row.data(), row.size());
+                }
+            }
+        }
+
+        /**
+         * @brief Loads the cells of a scenario compiled with compile_scenario().
+         * Everything was validated when the image was compiled so the cells are built as is
+         *
+         * @param file_in Path to the image
+        */
+        void add_cells_image(string const& file_in)
+        {
+            using namespace scenario_image;
+
+            mapped image(file_in);
+
+            phase_span<char const> chars             = image.get<char>(STRINGS);
+            phase_span<uint32_t const> string_starts = image.get<uint32_t>(STRING_OFFSETS);
+            auto get_string = [&](uint32_t s) { return string(chars.data() + string_starts[s], string_starts[s + 1] - string_starts[s]); };
+
+            // Configs
+            phase_span<uint32_t const> table_starts = image.get<uint32_t>(TABLES);
+            phase_span<uint32_t const> row_starts   = image.get<uint32_t>(ROWS);
+            phase_span<double const> rates          = image.get<double>(RATES);
+
+            vector<parsed_config> configs;
+            for (config_record const& record : image.get<config_record>(CONFIGS))
+            {
+                simulation_config config{};
+                config.prec_divider     = record.prec_divider;
+                config.reSusceptibility = record.reSusceptibility;
+                config.is_vaccination   = record.is_vaccination;
+
+                rate_tables tables;
+                uint32_t t = record.first_table;
+                for (rate_tables::phase_rates* table : tables.tables())
+                {
+                    for (uint32_t r = table_starts[t]; r < table_starts[t + 1]; ++r)
+                        table->emplace_back(rates.data() + row_starts[r], rates.data() + row_starts[r + 1]);
+                    ++t;
+                }
+
+                configs.push_back({nlohmann::json(), move(config), rates_registry.intern(move(tables))});
+            }
+
+            // Cells
+            phase_span<cell_record const> cells      = image.get<cell_record>(CELLS);
+            phase_span<state_record const> states    = image.get<state_record>(STATES);
+            phase_span<double const> values          = image.get<double>(STATE_VALUES);
+            phase_span<uint32_t const> edge_starts   = image.get<uint32_t>(ROW_OFFSETS);
+            phase_span<uint32_t const> neighbors     = image.get<uint32_t>(NEIGHBORS);
+            phase_span<double const> correlations    = image.get<double>(CORRELATIONS);
+            phase_span<uint32_t const> factor_starts = image.get<uint32_t>(FACTOR_OFFSETS);
+            phase_span<factor_record const> factors  = image.get<factor_record>(FACTORS);
+
+            for (uint32_t i = 0; i < cells.size(); ++i)
+            {
+                state_record const& record = states[i];
+                sevirds initial_state;
+                initial_state.population                       = record.population;
+                initial_state.disobedient                      = record.disobedient;
+                initial_state.hospital_capacity                = record.hospital_capacity;
+                initial_state.fatality_modifier                = record.fatality_modifier;
+                initial_state.min_interval_doses               = record.min_interval_doses;
+                initial_state.min_interval_recovery_to_vaccine = record.min_interval_recovery_to_vaccine;
+                initial_state.num_age_groups                   = record.num_age_groups;
+
+                array<unsigned int, sevirds::NUM_COMPARTMENTS> phases;
+                copy(record.phases.begin(), record.phases.end(), phases.begin());
+                initial_state.allocate(phases);
+                copy(values.data() + record.first_value, values.data() + record.first_value + initial_state.buffer.size(),
+                     initial_state.buffer.begin());
+
+                cell_unordered<vicinity> neighborhood;
+                for (uint32_t e = edge_starts[i]; e < edge_starts[i + 1]; ++e)
+                {
+                    vicinity& v  = neighborhood[get_string(cells[neighbors[e]].id)];
+                    v.correlation = correlations[e];
+                    for (uint32_t f = factor_starts[e]; f < factor_starts[e + 1]; ++f)
+                        v.correction_factors.insert({factors[f].infection_threshold, {factors[f].mobility_correction_factor, factors[f].hysteresis}});
+                }
+
+                add_parsed_cell(get_string(cells[i].type), get_string(cells[i].id), neighborhood, move(initial_state),
+                                get_string(cells[i].delay), configs.at(cells[i].config));
+            }
+        }
+
+        /**
+         * @brief Reads what's needed to add a cell. A field the cell doesn't have is taken from
+         * the default cell. The state and config are merged into the default ones as in Cadmium,
+         * a missing neighborhood is filled in once every cell has been read (see resolve_neighborhoods())
+         *
+         * @param cell_id ID of the cell
+         * @param cell JSON of the cell
+         * @param defaults The default cell
+         * @return scenario_cell
+        */
+        scenario_cell read_cell(string const& cell_id, nlohmann::json const& cell, default_cell& defaults)
+        {
+            static nlohmann::json const missing;
+            auto field = [&](char const* name) -> nlohmann::json const&
+            {
+                auto own = cell.find(name), fallback = defaults.json.find(name);
+                if (own != cell.end())
+                    return *own;
+                return fallback != defaults.json.end() ? *fallback : missing;
+            };
+
+            scenario_cell read;
+            read.id       = cell_id;
+            read.type     = field("cell_type").template get<string>();
+            read.delay_id = field("delay").template get<string>();
+
+            auto state = cell.find("state");
+            if (state != cell.end() && only_scalars(*state))
+            {
+                // Compact scenarios only give the population, start from the default state parsed once
+                if (!defaults.state)
+                    defaults.state.reset(new sevirds(defaults.json.value("state", missing).template get<sevirds>()));
+                read.initial_state = *defaults.state;
+                read_scalars(*state, read.initial_state);
+            }
+            else
+                read.initial_state = merged(cell, defaults.json, "state").template get<sevirds>();
+
+            auto neighborhood = cell.find("neighborhood");
+            read.default_neighborhood = neighborhood == cell.end();
+            if (!read.default_neighborhood)
+            {
+                for (auto& neighbor : neighborhood->items())
+                    read.neighborhood.emplace_back(neighbor.key(), neighbor.value().template get<vicinity>());
+            }
+
+            if (cell.find("config") != cell.end())
+                read.parsed = &parse_config(merged(cell, defaults.json, "config"));
+            else
+            {
+                // Nearly every cell, no need to hash the default config again
+                if (defaults.config == nullptr)
+                    defaults.config = &parse_config(field("config"));
+                read.parsed = defaults.config;
+            }
+
+            return read;
+        }
+
+        // Fields of a state that don't need the whole state to be read and validated again
+        static constexpr char const* SCALAR_FIELDS[] = { "population", "disobedient", "hospital_capacity", "fatality_modifier",
+                                                         "min_interval_between_doses", "min_interval_between_recovery_and_vaccine" };
+
+        static bool only_scalars(nlohmann::json const& state)
+        {
+            if (!state.is_object())
+                return false;
+
+            for (auto it = state.begin(); it != state.end(); ++it)
+            {
+                if (find(begin(SCALAR_FIELDS), end(SCALAR_FIELDS), it.key()) == end(SCALAR_FIELDS))
+                    return false;
+            }
+            return true;
+        }
+
+        static void read_scalars(nlohmann::json const& state, sevirds& initial_state)
+        {
+            auto read = [&](char const* name, auto& value)
+            {
+                auto it = state.find(name);
+                if (it != state.end())
+                    it->get_to(value);
+            };
+
+            read("population", initial_state.population);
+            read("disobedient", initial_state.disobedient);
+            read("hospital_capacity", initial_state.hospital_capacity);
+            read("fatality_modifier", initial_state.fatality_modifier);
+            read("min_interval_between_doses", initial_state.min_interval_doses);
+            read("min_interval_between_recovery_and_vaccine", initial_state.min_interval_recovery_to_vaccine);
+        }
+
+        /**
+         * @brief The default value of a field patched with the one of the cell
+         *
+         * @param cell JSON of the cell
+         * @param defaults JSON of the default cell
+         * @param name Field
+         * @return nlohmann::json
+        */
+        static nlohmann::json merged(nlohmann::json const& cell, nlohmann::json const& defaults, char const* name)
+        {
+            auto own = cell.find(name), fallback = defaults.find(name);
+            if (own == cell.end())
+                return fallback != defaults.end() ? *fallback : nlohmann::json();
+            if (fallback == defaults.end() || !own->is_object() || !fallback->is_object())
+                return *own;
+
+            // Generated scenarios give every cell its whole state, skip the copy of the default then
+            bool complete = true;
+            for (auto it = fallback->begin(); complete && it != fallback->end(); ++it)
+                complete = own->find(it.key()) != own->end();
+            if (complete)
+                return *own;
+
+            nlohmann::json patched = *fallback;
+            patched.merge_patch(*own);
+            return patched;
+        }
+
+        /**
+         * @brief Builds the compressed neighbor table before coupling the cells together.
+         * Must be called once all the cells have been added
+        */
+        void couple_cells()
+        {
+            graph->build();
+            if (as_region_set)
+                add_region_set();
+            else if (!detached)
+                cells_coupled<T, string, sevirds_message, vicinity>::couple_cells();
+        }
+
+        /**
+         * @brief Id of the model Cadmium makes of a cell, which the state and message logs name
+         *
+         * @param cell_id Id of the cell
+         * @return string
+        */
+        string cell_model_id(string const& cell_id) const
+        {
+            return this->get_id() + "_" + cell_id;
+        }
+
+        /**
+         * @brief Adds the one atomic model that steps every cell, named as Cadmium would name
+         * the first cell (see region_set.hpp)
+        */
+        void add_region_set()
+        {
+            auto cells = make_shared<lockstep_runner<T>>(detached_cells, graph, region_set_threads);
+            this->_models.push_back(cadmium::dynamic::translate::make_dynamic_atomic_model<region_set, T>(cell_model_id(detached_cells.front()->cell_id),
+                                                                                                          move(cells), region_set_log));
+        }
 };
 
 #endif //PANDEMIC_HOYA_2002_ZHONG_COUPLED_HPP
\ No newline at end of file
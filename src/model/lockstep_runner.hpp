@@ -0,0 +1,174 @@
+#ifndef PANDEMIC_HOYA_2002_LOCKSTEP_RUNNER_HPP
+#define PANDEMIC_HOYA_2002_LOCKSTEP_RUNNER_HPP
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <ostream>
+#include <iostream>
+#include <stdexcept>
+#include "cells/geographical_cell.hpp"
+#include "cells/neighborhood_graph.hpp"
+#include "cells/cell_pool.hpp"
+#include "cells_log.hpp"
+
+using namespace std;
+
+/**
+ * Steps every cell of a scenario outside of Cadmium. Each cell's output delay is one day,
+ * so Cadmium moves them all forward together anyway. Here they move in lockstep: all the
+ * cells compute day t + 1 from the day t states of their neighbors, and only then does
+ * any of them commit. The cells compute in parallel on a pool of threads (see cell_pool.hpp).
+ *
+ * Every cell is computed every day, where Cadmium only runs the transition of a cell when it
+ * or one of its neighbors changed. A cell none of them changed for is already at a fixed point,
+ * its state doesn't depend on the clock, so computing it again gives the same state. The runner
+ * tracks which cells Cadmium would have run so the days can be written to a cells_log the way
+ * Cadmium logs them, messages included (see cells_log.hpp).
+ *
+ * Usage: set geographical_coupled::detached before adding the cells, then
+ *        lockstep_runner<TIME> runner(coupled.detached_cells, coupled.graph, threads); runner.run_until(days, &log);
+ * or step it a day at a time with step() (see region_set.hpp).
+*/
+template <typename T>
+class lockstep_runner
+{
+    private:
+        vector<geographical_cell<T>*> cells;    // In the order they were added, which is the log order
+        vector<geographical_cell<T>*> by_index; // Dense id of the graph -> cell
+        shared_ptr<neighborhood_graph const> graph;
+
+        cell_pool<geographical_cell<T>> pool;
+        typename cell_pool<geographical_cell<T>>::task compute, commit;
+        T day = 0; // Being computed
+
+        // Indexed by cell_index, see cells_log
+        vector<unsigned char> changed;      // The cell's state changed into the day being computed
+        vector<unsigned char> transitioned; // Cadmium would run the cell's transition on the day
+
+        bool progress = false;
+
+    public:
+        /**
+         * @param detached_cells Cells of a geographical_coupled added with detached set, in the order they were added
+         * @param graph Graph of the same geographical_coupled, once its cells are coupled
+         * @param threads Number of threads stepping the cells, including the calling one
+        */
+        lockstep_runner(vector<shared_ptr<geographical_cell<T>>> const& detached_cells, shared_ptr<neighborhood_graph const> graph,
+                        unsigned int threads) : graph(move(graph)), pool(threads)
+        {
+            if (detached_cells.empty())
+                throw runtime_error{"There are no cells to run in lockstep, they must be added with geographical_coupled::detached set"};
+
+            by_index.resize(this->graph->num_cells(), nullptr);
+            for (shared_ptr<geographical_cell<T>> const& cell : detached_cells)
+            {
+                cells.push_back(cell.get());
+                by_index.at(cell->cell_index) = cell.get();
+            }
+
+            // The neighbors read the active buffers while each cell writes its inactive one
+            compute = [this](geographical_cell<T>& cell)
+            {
+                thread_local vector<sevirds_public const*> nstates;
+                nstates.clear();
+                for (unsigned int e = this->graph->row_begin(cell.cell_index); e < this->graph->row_end(cell.cell_index); ++e)
+                    nstates.push_back(&by_index[this->graph->neighbors[e]]->buffered_state());
+
+                cell.compute_step(day, nstates);
+            };
+            commit = [this](geographical_cell<T>& cell) { changed[cell.cell_index] = cell.commit_step(); };
+
+            // Every cell sends its first state
+            changed.assign(this->graph->num_cells(), 1);
+            transitioned.assign(this->graph->num_cells(), 1);
+        }
+
+        lockstep_runner(lockstep_runner const&) = delete;
+        lockstep_runner& operator=(lockstep_runner const&) = delete;
+
+    private:
+        // Marks the cells that changed into the day and the ones with a neighbor that did
+        void find_transitions()
+        {
+            neighborhood_graph const& g = *graph;
+            for (unsigned int c = 0; c < g.num_cells(); ++c)
+            {
+                unsigned char runs = changed[c];
+                for (unsigned int e = g.row_begin(c); e < g.row_end(c) && !runs; ++e)
+                    runs = changed[g.neighbors[e]];
+                transitioned[c] = runs;
+            }
+        }
+
+    public:
+
+        void turn_progress_on() { progress = true; }
+
+        /**
+         * @brief Steps every cell one day at a time
+         *
+         * @param until Day to stop at, it isn't computed (like Cadmium's runner)
+         * @param log Where each day goes, nothing is logged if it's null
+        */
+        void run_until(T until, cells_log<T>* log)
+        {
+            fill(changed.begin(), changed.end(), 1);
+
+            // Logging a day's transitions and the next day's states overlaps computing the next day
+            function<void()> log_day = nullptr;
+            if (log != nullptr)
+            {
+                log_day = [&]()
+                {
+                    if (day > 0)
+                        log->transitions(day - 1, cells, transitioned);
+                    log->log(day, cells, changed);
+                };
+            }
+
+            for (day = 0; day < until; day += 1)
+            {
+                pool.for_each_cell(cells, compute, log_day);
+                if (log != nullptr)
+                    find_transitions();
+                pool.for_each_cell(cells, commit);
+
+                if (progress)
+                    cout << "\r\033[33mDay " << day + 1 << " of " << until << "\033[0m" << flush;
+            }
+
+            if (log != nullptr)
+            {
+                if (day > 0)
+                    log->transitions(day - 1, cells, transitioned);
+                log->flush();
+            }
+        }
+
+        /**
+         * @brief Steps every cell one day, logged like a day of run_until()
+         *
+         * @param time Current day, the cells move to the next one
+         * @param log Where the day goes, nothing is logged if it's null
+        */
+        void step(T time, cells_log<T>* log = nullptr)
+        {
+            day = time;
+            if (log != nullptr)
+                log->log(day, cells, changed);
+
+            pool.for_each_cell(cells, compute);
+            if (log != nullptr)
+                find_transitions();
+            pool.for_each_cell(cells, commit);
+
+            if (log != nullptr)
+                log->transitions(day, cells, transitioned);
+        }
+
+        // In the order they were added, which is the log order
+        vector<geographical_cell<T>*> const& get_cells() const { return cells; }
+};
+
+#endif //PANDEMIC_HOYA_2002_LOCKSTEP_RUNNER_HPP
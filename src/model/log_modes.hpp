@@ -0,0 +1,138 @@
+#ifndef PANDEMIC_HOYA_2002_LOG_MODES_HPP
+#define PANDEMIC_HOYA_2002_LOG_MODES_HPP
+
+#include <memory>
+#include <string>
+#include <iostream>
+#include <cadmium/modeling/dynamic_coupled.hpp>
+#include <cadmium/engine/pdevs_dynamic_runner.hpp>
+#include <cadmium/logger/common_loggers.hpp>
+#include "async_log.hpp"
+
+using namespace std;
+
+/**
+ * Which logs a run writes, chosen with -log=MODE (see main.cpp):
+ *  all        - The state and message logs, what the GIS Web Viewer reads (default)
+ *  states     - Only ../logs/pandemic_state.txt
+ *  messages   - Only ../logs/pandemic_messages.txt
+ *  aggregates - Only the totals over every cell for each day, ../logs/pandemic_aggregates.csv (see cells_log.hpp)
+ *  binary     - Only the states, as binary columns in ../logs/pandemic_state.bin (see binary_state_log.hpp)
+ *  changes    - Only the states that changed each day, in ../logs/pandemic_state.txt (see cells_log.hpp)
+ *  none       - Nothing
+ *
+ * Cadmium's loggers are picked when the runner is compiled, so the runner is compiled once for
+ * each mode and a log that's off is never formatted. Only the files of the mode are opened, they're
+ * written by threads of their own (see async_log.hpp).
+*/
+enum class log_mode { all, states, messages, aggregates, binary, changes, none };
+
+/**
+ * @brief Reads the mode of a -log= flag
+ *
+ * @param name Mode after the '='
+ * @param mode Set to the mode when the name is known
+ * @return bool Whether the name is known
+*/
+bool parse_log_mode(string const& name, log_mode& mode)
+{
+    if (name == "all")             mode = log_mode::all;
+    else if (name == "states")     mode = log_mode::states;
+    else if (name == "messages")   mode = log_mode::messages;
+    else if (name == "aggregates") mode = log_mode::aggregates;
+    else if (name == "binary")     mode = log_mode::binary;
+    else if (name == "changes")    mode = log_mode::changes;
+    else if (name == "none")       mode = log_mode::none;
+    else
+        return false;
+    return true;
+}
+
+namespace log_files
+{
+    inline async_log_file& messages()   { static async_log_file file; return file; }
+    inline async_log_file& state()      { static async_log_file file; return file; }
+    inline async_log_file& aggregates() { static async_log_file file; return file; }
+    inline async_log_file& binary()     { static async_log_file file; return file; }
+
+    /**
+     * @brief Opens (and empties) the log files a mode writes
+     *
+     * @param mode Logs of the run
+    */
+    void open(log_mode mode)
+    {
+        if (mode == log_mode::all || mode == log_mode::messages)
+            messages().open("../logs/pandemic_messages.txt");
+        if (mode == log_mode::all || mode == log_mode::states || mode == log_mode::changes)
+            state().open("../logs/pandemic_state.txt");
+        if (mode == log_mode::aggregates)
+            aggregates().open("../logs/pandemic_aggregates.csv");
+        if (mode == log_mode::binary)
+            binary().open("../logs/pandemic_state.bin");
+    }
+} //namespace log_files
+
+/*************** Loggers *******************/
+struct oss_sink_messages { static ostream& sink() { return log_files::messages(); } };
+struct oss_sink_state    { static ostream& sink() { return log_files::state();    } };
+
+template <typename T>
+using state_logger         = cadmium::logger::logger<cadmium::logger::logger_state,       cadmium::dynamic::logger::formatter<T>, oss_sink_state>;
+template <typename T>
+using messages_logger      = cadmium::logger::logger<cadmium::logger::logger_messages,    cadmium::dynamic::logger::formatter<T>, oss_sink_messages>;
+template <typename T>
+using global_time_mes      = cadmium::logger::logger<cadmium::logger::logger_global_time, cadmium::dynamic::logger::formatter<T>, oss_sink_messages>;
+template <typename T>
+using global_time_sta      = cadmium::logger::logger<cadmium::logger::logger_global_time, cadmium::dynamic::logger::formatter<T>, oss_sink_state>;
+
+template <typename T>
+using logger_top           = cadmium::logger::multilogger<state_logger<T>, messages_logger<T>, global_time_mes<T>, global_time_sta<T>>;
+template <typename T>
+using logger_states_only   = cadmium::logger::multilogger<state_logger<T>, global_time_sta<T>>;
+template <typename T>
+using logger_messages_only = cadmium::logger::multilogger<messages_logger<T>, global_time_mes<T>>;
+
+/**
+ * @brief Runs a model with Cadmium's runner and the given loggers
+ *
+ * @param top Top model
+ * @param until Simulation time to stop at
+ * @param progress Whether to show the progress meter
+*/
+template <typename LOGGER, typename T>
+void run_cadmium(shared_ptr<cadmium::dynamic::modeling::coupled<T>> top, T until, bool progress)
+{
+    cadmium::dynamic::engine::runner<T, LOGGER> r(top, {0});
+
+    if (progress)
+        r.turn_progress_on();
+
+    r.run_until(until);
+}
+
+/**
+ * @brief Runs a model with Cadmium's runner and the loggers of a mode. Cadmium doesn't log
+ * aggregates, binary states or changes, they're written by the model (see region_set.hpp)
+ *
+ * @param mode Logs of the run
+ * @param top Top model
+ * @param until Simulation time to stop at
+ * @param progress Whether to show the progress meter
+*/
+template <typename T>
+void run_cadmium(log_mode mode, shared_ptr<cadmium::dynamic::modeling::coupled<T>> top, T until, bool progress)
+{
+    switch (mode)
+    {
+        case log_mode::all:        run_cadmium<logger_top<T>>(top, until, progress);               break;
+        case log_mode::states:     run_cadmium<logger_states_only<T>>(top, until, progress);       break;
+        case log_mode::messages:   run_cadmium<logger_messages_only<T>>(top, until, progress);     break;
+        case log_mode::aggregates:
+        case log_mode::binary:
+        case log_mode::changes:
+        case log_mode::none:       run_cadmium<cadmium::logger::not_logger>(top, until, progress); break;
+    }
+}
+
+#endif //PANDEMIC_HOYA_2002_LOG_MODES_HPP
@@ -0,0 +1,126 @@
+#ifndef PANDEMIC_HOYA_2002_MAPPED_FILE_HPP
+#define PANDEMIC_HOYA_2002_MAPPED_FILE_HPP
+
+#include <new>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+
+// Only the headers of the platform that's built for
+#if defined(_WIN32)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #define PANDEMIC_HOYA_2002_MMAP
+#endif
+
+using namespace std;
+
+/**
+ * A whole file mapped read only into memory (see scenario_image.hpp). It's mapped with
+ * MapViewOfFile on Windows and mmap on POSIX systems; anywhere else it's read into a buffer
+ * aligned like the mapping would be, which costs a copy but reads the same.
+*/
+class mapped_file
+{
+    public:
+        // A mapping starts on a page, the buffer only has to hold any of the values in the file
+        static constexpr size_t ALIGNMENT = 64;
+
+    private:
+        void const* view = nullptr;
+        size_t length    = 0;
+
+        void release()
+        {
+            if (view == nullptr)
+                return;
+#if defined(_WIN32)
+            UnmapViewOfFile(view);
+#elif defined(PANDEMIC_HOYA_2002_MMAP)
+            munmap(const_cast<void*>(view), length);
+#else
+            ::operator delete(const_cast<void*>(view), align_val_t{ALIGNMENT});
+#endif
+            view = nullptr;
+        }
+
+    public:
+        /**
+         * @param path File to map, it mustn't be empty
+        */
+        explicit mapped_file(string const& path)
+        {
+#if defined(_WIN32)
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                throw runtime_error{"Unable to open the file: " + path};
+
+            LARGE_INTEGER size;
+            if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+            {
+                length = size.QuadPart;
+
+                // The view keeps the mapping open once it's closed here
+                HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping != nullptr)
+                {
+                    view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                    CloseHandle(mapping);
+                }
+            }
+            CloseHandle(file);
+#elif defined(PANDEMIC_HOYA_2002_MMAP)
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw runtime_error{"Unable to open the file: " + path};
+
+            struct stat info;
+            if (fstat(fd, &info) == 0 && info.st_size > 0)
+            {
+                length = info.st_size;
+                void* data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED)
+                    view = data;
+            }
+            close(fd);
+#else
+            ifstream file(path, ios::binary | ios::ate);
+            if (!file.is_open())
+                throw runtime_error{"Unable to open the file: " + path};
+
+            streamoff size = file.tellg();
+            if (size > 0)
+            {
+                length = size;
+                char* buffer = static_cast<char*>(::operator new(length, align_val_t{ALIGNMENT}));
+                file.seekg(0);
+                if (file.read(buffer, length))
+                    view = buffer;
+                else
+                    ::operator delete(buffer, align_val_t{ALIGNMENT});
+            }
+#endif
+            if (view == nullptr)
+                throw runtime_error{"Unable to map the file: " + path};
+        }
+
+        mapped_file(mapped_file const&) = delete;
+        mapped_file& operator=(mapped_file const&) = delete;
+
+        ~mapped_file() { release(); }
+
+        void const* data() const { return view;   }
+        size_t size() const      { return length; }
+};
+
+#endif //PANDEMIC_HOYA_2002_MAPPED_FILE_HPP
@@ -0,0 +1,79 @@
+#ifndef PANDEMIC_HOYA_2002_REGION_SET_HPP
+#define PANDEMIC_HOYA_2002_REGION_SET_HPP
+
+#include <tuple>
+#include <memory>
+#include <ostream>
+#include <cadmium/modeling/ports.hpp>
+#include <cadmium/modeling/message_bag.hpp>
+#include "lockstep_runner.hpp"
+
+using namespace std;
+
+/**
+ * Every cell of a scenario as one atomic model. Cadmium schedules a single model once a day
+ * instead of every cell, and routes no messages; the cells are stepped in lockstep inside it
+ * (see lockstep_runner.hpp). It has no ports.
+ *
+ * Cadmium's loggers would only see the one model, so the days are written to a cells_log
+ * instead, which writes the cells' states and the messages they'd have sent as Cadmium would
+ * have (see cells_log.hpp). Cadmium's loggers are left off, they'd only log how many cells the
+ * model steps.
+ *
+ * Usage: set geographical_coupled::as_region_set before adding the cells
+*/
+template <typename T>
+class region_set
+{
+    public:
+        using input_ports  = tuple<>;
+        using output_ports = tuple<>;
+
+        struct state_type
+        {
+            shared_ptr<lockstep_runner<T>> cells;
+            shared_ptr<cells_log<T>> log; // Can be null
+            T time = 0; // Day the cells are on, the next one to compute
+        };
+        state_type state;
+
+        region_set() = default;
+
+        /**
+         * @param cells Cells of the scenario, the first one names the model
+         * @param log Where each day goes, can be null
+        */
+        explicit region_set(shared_ptr<lockstep_runner<T>> cells, shared_ptr<cells_log<T>> log = nullptr)
+        {
+            state.cells = move(cells);
+            state.log   = move(log);
+        }
+
+        void internal_transition()
+        {
+            state.cells->step(state.time, state.log.get());
+            state.time += 1;
+        }
+
+        // There are no input ports so nothing ever arrives
+        void external_transition(T e, typename cadmium::make_message_bags<input_ports>::type mbs) { }
+
+        void confluence_transition(T e, typename cadmium::make_message_bags<input_ports>::type mbs)
+        {
+            internal_transition();
+        }
+
+        typename cadmium::make_message_bags<output_ports>::type output() const { return {}; }
+
+        // The cells' first transitions are when the simulation starts, then like their
+        // output_delay() they all move one day at a time
+        T time_advance() const { return state.time == 0 ? 0 : 1; }
+
+        // The states are logged by the cells_log
+        friend ostream& operator<<(ostream& os, state_type const& s)
+        {
+            return os << s.cells->get_cells().size() << " cells on day " << s.time;
+        }
+};
+
+#endif //PANDEMIC_HOYA_2002_REGION_SET_HPP
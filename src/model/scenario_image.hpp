@@ -0,0 +1,242 @@
+#ifndef PANDEMIC_HOYA_2002_SCENARIO_IMAGE_HPP
+#define PANDEMIC_HOYA_2002_SCENARIO_IMAGE_HPP
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include "cells/phase_span.hpp"
+#include "cells/sevirds.hpp"
+#include "mapped_file.hpp"
+
+using namespace std;
+
+/**
+ * Binary image of a compiled scenario (see the compile-scenario mode of main.cpp).
+ * The JSON is read and validated once, after which everything needed to build the
+ * cells is stored as flat arrays that are used straight from the mapped file:
+ *
+ *  - cells get dense ids in the order they're added, their strings are in one table;
+ *  - the neighborhoods are a compressed sparse row table, each row in scenario order;
+ *  - every distinct config is stored once and cells refer to it by index;
+ *  - the initial states are one array of doubles laid out like sevirds::buffer.
+ *
+ * The image is only meant to be read on the machine that wrote it, the header
+ * records the byte order and the version so a stale or foreign image is rejected.
+*/
+namespace scenario_image
+{
+    constexpr char MAGIC[8]            = {'P', 'A', 'N', 'D', 'I', 'M', 'G', '\0'};
+    constexpr uint32_t VERSION         = 1;
+    constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    // Sections of the image, in the order they're written
+    enum section
+    {
+        STRINGS,        // char,         every string back to back
+        STRING_OFFSETS, // uint32_t,     start of each string (size: strings + 1)
+        CELLS,          // cell_record,  in the order they're added
+        STATES,         // state_record, one per cell
+        STATE_VALUES,   // double,       sevirds::buffer of every cell
+        CONFIGS,        // config_record
+        TABLES,         // uint32_t,     first row of each rate table (size: tables + 1)
+        ROWS,           // uint32_t,     first value of each row (size: rows + 1)
+        RATES,          // double
+        ROW_OFFSETS,    // uint32_t,     first edge of each cell (size: cells + 1)
+        NEIGHBORS,      // uint32_t,     dense id of the neighbor
+        CORRELATIONS,   // double
+        FACTOR_OFFSETS, // uint32_t,     first correction factor of each edge (size: edges + 1)
+        FACTORS,        // factor_record
+        NUM_SECTIONS
+    };
+
+    struct section_entry
+    {
+        uint64_t offset;
+        uint64_t size; // Bytes
+    };
+
+    struct header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        array<section_entry, NUM_SECTIONS> sections;
+    };
+
+    struct cell_record
+    {
+        uint32_t id;     // Strings
+        uint32_t type;
+        uint32_t delay;
+        uint32_t config; // Configs
+    };
+
+    // The scalars of a sevirds, its values start at first_value in STATE_VALUES
+    struct state_record
+    {
+        double population;
+        double disobedient;
+        double hospital_capacity;
+        double fatality_modifier;
+        uint32_t min_interval_doses;
+        uint32_t min_interval_recovery_to_vaccine;
+        uint32_t num_age_groups;
+        uint32_t first_value;
+        array<uint32_t, sevirds::NUM_COMPARTMENTS> phases;
+    };
+
+    struct config_record
+    {
+        int32_t prec_divider;
+        uint8_t reSusceptibility;
+        uint8_t is_vaccination;
+        uint8_t padding[2];
+        uint32_t first_table; // Tables, one for each of rate_tables::tables()
+    };
+
+    // One entry of vicinity::correction_factors
+    struct factor_record
+    {
+        float infection_threshold;
+        float mobility_correction_factor;
+        float hysteresis;
+    };
+
+    /**
+     * Builds an image in memory, section by section.
+    */
+    class writer
+    {
+        private:
+            array<vector<char>, NUM_SECTIONS> sections;
+
+        public:
+            template <typename V>
+            void push(section s, V const& value)
+            {
+                static_assert(is_trivially_copyable<V>::value, "Only plain values can go in an image");
+                char const* bytes = reinterpret_cast<char const*>(&value);
+                sections[s].insert(sections[s].end(), bytes, bytes + sizeof(V));
+            }
+
+            template <typename V>
+            void push(section s, V const* values, size_t count)
+            {
+                static_assert(is_trivially_copyable<V>::value, "Only plain values can go in an image");
+                char const* bytes = reinterpret_cast<char const*>(values);
+                sections[s].insert(sections[s].end(), bytes, bytes + sizeof(V) * count);
+            }
+
+            // Number of values of type V written to a section so far
+            template <typename V>
+            uint32_t count(section s) const { return sections[s].size() / sizeof(V); }
+
+            /**
+             * @brief Writes the header followed by every section, each aligned to 8 bytes
+             *
+             * @param file_out Path of the image
+            */
+            void save(string const& file_out) const
+            {
+                header head{};
+                memcpy(head.magic, MAGIC, sizeof(MAGIC));
+                head.version    = VERSION;
+                head.byte_order = BYTE_ORDER_MARK;
+
+                uint64_t offset = sizeof(header);
+                for (unsigned int s = 0; s < NUM_SECTIONS; ++s)
+                {
+                    offset = (offset + 7) & ~uint64_t(7);
+                    head.sections[s] = {offset, sections[s].size()};
+                    offset += sections[s].size();
+                }
+
+                ofstream file(file_out, ios::binary | ios::trunc);
+                if (!file.is_open())
+                    throw runtime_error{"Unable to open the file: " + file_out};
+
+                file.write(reinterpret_cast<char const*>(&head), sizeof(header));
+                uint64_t written = sizeof(header);
+                for (unsigned int s = 0; s < NUM_SECTIONS; ++s)
+                {
+                    static char const zeros[8] = {};
+                    file.write(zeros, head.sections[s].offset - written);
+                    file.write(sections[s].data(), sections[s].size());
+                    written = head.sections[s].offset + sections[s].size();
+                }
+
+                if (!file)
+                    throw runtime_error{"Failed to write the scenario image: " + file_out};
+            }
+    };
+
+    /**
+     * An image mapped read only into memory (see mapped_file.hpp). The sections are viewed in place.
+    */
+    class mapped
+    {
+        private:
+            mapped_file file;
+
+            header const& head() const { return *static_cast<header const*>(file.data()); }
+
+            // Why the mapped file can't be used, empty if it can
+            string check(string const& file_in) const
+            {
+                size_t const length = file.size();
+                if (length < sizeof(header))
+                    return "The scenario image is truncated: " + file_in;
+                if (memcmp(head().magic, MAGIC, sizeof(MAGIC)) != 0 || head().byte_order != BYTE_ORDER_MARK)
+                    return file_in + " is not a scenario image compiled on this machine";
+                if (head().version != VERSION)
+                    return file_in + " was compiled by another version of the model, compile it again";
+
+                for (section_entry const& s : head().sections)
+                {
+                    if (s.offset % 8 != 0 || s.offset > length || s.size > length - s.offset)
+                        return "The scenario image is truncated: " + file_in;
+                }
+                return "";
+            }
+
+        public:
+            explicit mapped(string const& file_in) : file(file_in)
+            {
+                string error = check(file_in);
+                if (!error.empty())
+                    throw runtime_error{error};
+            }
+
+            mapped(mapped const&) = delete;
+            mapped& operator=(mapped const&) = delete;
+
+            template <typename V>
+            phase_span<V const> get(section s) const
+            {
+                section_entry const& entry = head().sections[s];
+                return phase_span<V const>(reinterpret_cast<V const*>(static_cast<char const*>(file.data()) + entry.offset),
+                                           entry.size / sizeof(V));
+            }
+
+            /**
+             * @brief Whether a file starts like an image, so it can be told apart from a JSON scenario
+             *
+             * @param file_in Path to the scenario
+             * @return bool
+            */
+            static bool is_image(string const& file_in)
+            {
+                char magic[sizeof(MAGIC)] = {};
+                ifstream file(file_in, ios::binary);
+                file.read(magic, sizeof(magic));
+                return file && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+            }
+    };
+} //namespace scenario_image
+
+#endif //PANDEMIC_HOYA_2002_SCENARIO_IMAGE_HPP
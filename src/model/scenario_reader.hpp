@@ -0,0 +1,151 @@
+#ifndef PANDEMIC_HOYA_2002_SCENARIO_READER_HPP
+#define PANDEMIC_HOYA_2002_SCENARIO_READER_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+
+/**
+ * Reads a scenario file through nlohmann's SAX interface rather than loading the whole
+ * document. The entries of the top level collections it's given (e.g. the cells under
+ * "cells" or the edges under "edges") are built one at a time; once an entry ends it's
+ * handed to the callback of its collection and thrown away, so a scenario never has to
+ * fit in memory as a DOM. Anything else is skipped.
+ *
+ * Usage: nlohmann::json::sax_parse(file, &reader)
+*/
+class scenario_reader
+{
+    public:
+        using json     = nlohmann::json;
+        using callback = function<void(std::string const& key, json&& entry)>; // The key is empty in an array
+
+    private:
+        unordered_map<std::string, callback> collections;
+
+        unsigned int depth    = 0;       // Objects and arrays currently open, the document itself is 1
+        callback* current     = nullptr; // Collection being read
+        bool current_is_array = false;
+        std::string last_key;            // Key of the value about to be read
+
+        std::string entry_key;
+        json entry;                      // Entry being read
+        vector<json*> open;              // Objects and arrays of the entry being read, innermost last
+
+        /**
+         * @brief Adds a value to the innermost object or array of the entry being read
+         *
+         * @param value Value just read
+         * @return json* Where the value was stored
+        */
+        json* add(json&& value)
+        {
+            json& parent = *open.back();
+            if (parent.is_array())
+            {
+                parent.push_back(move(value));
+                return &parent.back();
+            }
+
+            json& slot = parent[last_key];
+            slot = move(value);
+            return &slot;
+        }
+
+        bool scalar(json&& value)
+        {
+            if (!open.empty())
+                add(move(value));
+            return true;
+        }
+
+        /**
+         * @brief Called when an object or array starts
+         *
+         * @param container Empty object or array
+         * @param is_array Whether it's an array
+        */
+        void start(json&& container, bool is_array)
+        {
+            ++depth;
+
+            if (!open.empty())
+                open.push_back(add(move(container)));
+            else if (current != nullptr && depth == 3)
+            {
+                // A new entry, in an object its key is the key just read
+                entry_key = current_is_array ? "" : last_key;
+                entry     = move(container);
+                open.push_back(&entry);
+            }
+            else if (depth == 2)
+            {
+                auto it = collections.find(last_key);
+                if (it != collections.end())
+                {
+                    current          = &it->second;
+                    current_is_array = is_array;
+                }
+            }
+        }
+
+        // Called when an object or array ends
+        void end()
+        {
+            if (!open.empty())
+            {
+                open.pop_back();
+                if (open.empty())
+                {
+                    (*current)(entry_key, move(entry));
+                    entry = json();
+                }
+            }
+            else if (depth == 2)
+                current = nullptr;
+
+            --depth;
+        }
+
+    public:
+        /**
+         * @param collections Name of each top level collection to read -> called with each of its entries
+        */
+        explicit scenario_reader(unordered_map<std::string, callback> collections) : collections(move(collections)) { }
+
+        bool null()                                  { return scalar(json(nullptr)); }
+        bool boolean(bool value)                     { return scalar(json(value));   }
+        bool number_integer(json::number_integer_t value)           { return scalar(json(value)); }
+        bool number_unsigned(json::number_unsigned_t value)         { return scalar(json(value)); }
+        bool number_float(json::number_float_t value, std::string const&) { return scalar(json(value)); }
+        bool string(json::string_t& value)           { return scalar(json(move(value))); }
+
+        // Scenarios are text so there's nothing to do with binary values.
+        // A template so it works with versions of the library that don't have them
+        template <typename B>
+        bool binary(B&) { return true; }
+
+        // Named string() by the SAX interface, which is why the type is spelled std::string in here
+        bool key(json::string_t& value)
+        {
+            last_key = move(value);
+            return true;
+        }
+
+        bool start_object(size_t) { start(json::object(), false); return true; }
+        bool end_object()         { end(); return true; }
+        bool start_array(size_t)  { start(json::array(), true);   return true; }
+        bool end_array()          { end(); return true; }
+
+        bool parse_error(size_t position, std::string const& last_token, nlohmann::detail::exception const& e)
+        {
+            throw runtime_error{"Invalid scenario at byte " + to_string(position) + " near '" + last_token + "': " + e.what()};
+        }
+};
+
+#endif //PANDEMIC_HOYA_2002_SCENARIO_READER_HPP